@@ -0,0 +1,989 @@
+#include "asciimation.hh"
+#include "header.hh"
+#include "plan.hh"
+#include "diff.hh"
+#include "mmap.hh"
+#include "output.hh"
+#include "compiled.hh"
+#include "scan.hh"
+#include "layers.hh"
+#include "timeline.hh"
+#include "packed.hh"
+#include "ahead.hh"
+#include "color.hh"
+
+#include "parg.hh"
+using Parg = OB::Parg;
+
+#include "ansi_escape_codes.hh"
+namespace AEC = OB::ANSI_Escape_Codes;
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <regex>
+#include <chrono>
+#include <random>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+
+using Clock = std::chrono::steady_clock;
+
+// shape of the generated animation
+struct Config
+{
+  size_t frames {200};
+  size_t width {80};
+  size_t height {24};
+  double change {0.1};
+  size_t headers {64};
+  size_t iterations {20};
+  unsigned long seed {1};
+}; // struct Config
+
+struct Result
+{
+  std::string name;
+  double value {0};
+  std::string unit;
+}; // struct Result
+
+// removes a temporary file when it goes out of scope
+class Temp
+{
+public:
+  explicit Temp(std::string const& str);
+  Temp(Temp const&) = delete;
+  Temp& operator=(Temp const&) = delete;
+  ~Temp();
+
+  std::string const& name() const;
+
+private:
+  std::string name_;
+
+}; // class Temp
+
+// counts what it is handed instead of writing it
+class Count_Sink : public OB::Sink
+{
+public:
+  void write(struct iovec* iov, size_t cnt) override;
+  void end() override;
+
+  size_t writes {0};
+  size_t bytes {0};
+  size_t frames {0};
+
+}; // class Count_Sink
+
+int program_options(Parg& pg);
+double elapsed(Clock::time_point start);
+double time_ns(size_t iterations, std::function<void()> const& fn);
+std::vector<std::string> header_lines(size_t count);
+std::string generate(Config const& cfg);
+void report(std::vector<Result>& results, std::string const& name, double value, std::string const& unit);
+void write_json(std::ostream& os, Config const& cfg, std::string const& file_name, std::vector<Result> const& results);
+void bench_headers(Config const& cfg, std::vector<Result>& results);
+OB::Plan load(std::string const& file_name, bool regex);
+void bench_load(Config const& cfg, std::string const& file_name, std::vector<Result>& results);
+void bench_render(Config const& cfg, std::string const& file_name, std::vector<Result>& results);
+std::string tall_frames();
+void bench_writes(Config const& cfg, std::vector<Result>& results);
+void check_writes();
+void bench_ahead(Config const& cfg, std::string const& file_name, std::vector<Result>& results);
+void check_ahead(Config const& cfg);
+void check_packed(Config const& cfg);
+void bench_layers(Config const& cfg, std::string const& file_name, std::vector<Result>& results);
+void bench_first_frame(Config const& cfg, std::string const& file_name, std::vector<Result>& results);
+
+Temp::Temp(std::string const& str)
+{
+  char path[] {"/tmp/asciimation_bench.XXXXXX"};
+  int const fd {mkstemp(path)};
+  if (fd == -1)
+  {
+    throw std::runtime_error("could not create a temporary file");
+  }
+  name_ = path;
+
+  bool const ok {write(fd, str.data(), str.size()) == static_cast<ssize_t>(str.size())};
+  close(fd);
+  if (! ok)
+  {
+    unlink(path);
+    throw std::runtime_error("could not write a temporary file");
+  }
+}
+
+Temp::~Temp()
+{
+  unlink(name_.c_str());
+}
+
+std::string const& Temp::name() const
+{
+  return name_;
+}
+
+void Count_Sink::write(struct iovec* iov, size_t cnt)
+{
+  ++writes;
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    bytes += iov[i].iov_len;
+  }
+}
+
+void Count_Sink::end()
+{
+  ++frames;
+}
+
+int program_options(Parg& pg)
+{
+  pg.name("asciimation_bench").version("0.4.0 (03.04.2018)");
+  pg.description("asciimation hot path benchmarks");
+  pg.usage("[-f|--file input_file] [-n|--iterations count] [--frames count] [--width cols] [--height rows] [--change ratio] [--headers count] [--seed int] [--json file_name]");
+  pg.usage("[--check]");
+  pg.usage("[-h|--help]");
+  pg.info("Examples", {
+    "asciimation_bench --frames 1000 --width 200 --height 60 --change 0.05",
+    "asciimation_bench -f './examples/plane' --json results.json",
+  });
+  pg.author("Brett Robinson (octobanana) <octobanana.dev@gmail.com>");
+
+  pg.set("help,h", "print the help output");
+  pg.set("file,f", "", "file_name", "benchmark an existing animation instead of a generated one");
+  pg.set("iterations,n", "20", "int", "the number of timed runs of each benchmark");
+  pg.set("frames", "200", "int", "the number of generated frames");
+  pg.set("width", "80", "int", "the width of the generated frames");
+  pg.set("height", "24", "int", "the height of the generated frames");
+  pg.set("change", "0.1", "float", "the ratio of cells that change between generated frames");
+  pg.set("headers", "64", "int", "the number of generated header lines");
+  pg.set("seed", "1", "int", "the seed of the generator");
+  pg.set("json", "", "file_name", "write the results as json, '-' writes them to stdout");
+  pg.set("check", "run the correctness checks instead of the benchmarks, exits with 1 if one fails");
+
+  int status {pg.parse()};
+  if (status < 0)
+  {
+    std::cout << pg.print_help() << "\n";
+    std::cout << "Error: " << pg.error() << "\n";
+    return -1;
+  }
+  if (pg.get<bool>("help"))
+  {
+    std::cout << pg.print_help();
+    return 1;
+  }
+  return 0;
+}
+
+// nanoseconds since start
+double elapsed(Clock::time_point start)
+{
+  return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+// median nanoseconds of a single call
+double time_ns(size_t iterations, std::function<void()> const& fn)
+{
+  std::vector<double> times;
+  times.reserve(iterations);
+  for (size_t n = 0; n < iterations; ++n)
+  {
+    auto const start = Clock::now();
+    fn();
+    times.emplace_back(elapsed(start));
+  }
+  std::sort(times.begin(), times.end());
+  return times.at(times.size() / 2);
+}
+
+std::vector<std::string> header_lines(size_t count)
+{
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < count; ++i)
+  {
+    lines.emplace_back("header_" + std::to_string(i) + " : value " + std::to_string(i * 7));
+  }
+  return lines;
+}
+
+// a random first frame, every following frame rewrites
+// the given ratio of randomly picked cells
+std::string generate(Config const& cfg)
+{
+  std::mt19937 rng (cfg.seed);
+  std::uniform_int_distribution<int> glyph ('!', '~');
+  std::uniform_int_distribution<size_t> cell (0, cfg.width * cfg.height - 1);
+  size_t const changes {static_cast<size_t>(cfg.change * static_cast<double>(cfg.width * cfg.height))};
+
+  std::string str {"x:" + std::to_string(cfg.width) + "\ny:" + std::to_string(cfg.height) + "\n"};
+  for (auto const& e : header_lines(cfg.headers))
+  {
+    str += e + "\n";
+  }
+  str += "BEGIN\n";
+
+  std::string frame (cfg.width * cfg.height, ' ');
+  for (auto& e : frame)
+  {
+    e = static_cast<char>(glyph(rng));
+  }
+
+  for (size_t f = 0; f < cfg.frames; ++f)
+  {
+    if (f > 0)
+    {
+      for (size_t i = 0; i < changes; ++i)
+      {
+        frame[cell(rng)] = static_cast<char>(glyph(rng));
+      }
+    }
+
+    for (size_t r = 0; r < cfg.height; ++r)
+    {
+      str.append(frame, r * cfg.width, cfg.width);
+      str += "\n";
+    }
+    if (f + 1 < cfg.frames)
+    {
+      str += "END\n";
+    }
+  }
+
+  return str;
+}
+
+void report(std::vector<Result>& results, std::string const& name, double value, std::string const& unit)
+{
+  results.emplace_back(Result {name, value, unit});
+}
+
+void write_json(std::ostream& os, Config const& cfg, std::string const& file_name, std::vector<Result> const& results)
+{
+  // names, units and file names are plain text, only quotes and backslashes are escaped
+  auto const quote = [](std::string const& str)
+  {
+    std::string res {"\""};
+    for (auto const c : str)
+    {
+      if (c == '"' || c == '\\') res += '\\';
+      res += c;
+    }
+    return res + "\"";
+  };
+
+  os << "{\n";
+  os << "  \"config\": {\n";
+  if (file_name.empty())
+  {
+    os << "    \"frames\": " << cfg.frames << ",\n";
+    os << "    \"width\": " << cfg.width << ",\n";
+    os << "    \"height\": " << cfg.height << ",\n";
+    os << "    \"change\": " << cfg.change << ",\n";
+    os << "    \"headers\": " << cfg.headers << ",\n";
+    os << "    \"seed\": " << cfg.seed << ",\n";
+  }
+  else
+  {
+    os << "    \"file\": " << quote(file_name) << ",\n";
+  }
+  os << "    \"iterations\": " << cfg.iterations << "\n";
+  os << "  },\n";
+  os << "  \"results\": [\n";
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    auto const& e = results.at(i);
+    os << "    {\"name\": " << quote(e.name) << ", \"value\": " << std::fixed << std::setprecision(3) << e.value << ", \"unit\": " << quote(e.unit) << "}";
+    os << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  os << "  ]\n";
+  os << "}\n";
+}
+
+void bench_headers(Config const& cfg, std::vector<Result>& results)
+{
+  auto const lines = header_lines(cfg.headers);
+  std::map<std::string, std::string> headers;
+  std::string key;
+  std::string value;
+  size_t col {0};
+  double const count {static_cast<double>(lines.size())};
+
+  // the player used to build the pattern once per line
+  report(results, "header.regex", time_ns(cfg.iterations, [&]()
+  {
+    for (auto const& e : lines)
+    {
+      std::smatch m;
+      if (std::regex_match(e, m, std::regex("^(.+?)\\s*:\\s*(.+)$")))
+      {
+        headers[std::string(m[1])] = std::string(m[2]);
+      }
+    }
+  }) / count, "ns/header");
+
+  report(results, "header.tokenizer", time_ns(cfg.iterations, [&]()
+  {
+    for (auto const& e : lines)
+    {
+      if (OB::Header::parse(e.data(), e.size(), key, value, col))
+      {
+        headers[key] = value;
+      }
+    }
+  }) / count, "ns/header");
+}
+
+// the text load path of the player, map the file, parse the headers
+// and index the frames
+OB::Plan load(std::string const& file_name, bool regex)
+{
+  OB::Mmap map {file_name};
+  char const* const first {map.data()};
+  char const* const last {first + map.size()};
+
+  std::map<std::string, std::string> headers;
+  std::string key;
+  std::string value;
+  size_t col {0};
+  char const* pos {first};
+  while (pos != last)
+  {
+    auto const eol = static_cast<char const*>(std::memchr(pos, '\n', static_cast<size_t>(last - pos)));
+    std::string const line (pos, eol ? eol : last);
+    pos = eol ? eol + 1 : last;
+    if (line == "BEGIN") break;
+
+    if (regex)
+    {
+      std::smatch m;
+      if (! std::regex_match(line, m, std::regex("^(.+?)\\s*:\\s*(.+)$")))
+      {
+        throw std::runtime_error("invalid header syntax");
+      }
+      headers[std::string(m[1])] = std::string(m[2]);
+    }
+    else
+    {
+      if (! OB::Header::parse(line.data(), line.size(), key, value, col))
+      {
+        throw std::runtime_error("invalid header syntax");
+      }
+      headers[key] = value;
+    }
+  }
+
+  return OB::Plan(std::move(map), static_cast<size_t>(pos - first), "END\n");
+}
+
+void bench_load(Config const& cfg, std::string const& file_name, std::vector<Result>& results)
+{
+  size_t size {0};
+  size_t offset {0};
+  {
+    // frame offsets of a text plan are relative to the start of the file
+    auto const plan = load(file_name, false);
+    size = OB::Mmap(file_name).size();
+    offset = plan.frames()[0].off;
+  }
+
+  // finding every newline with each kernel the cpu supports
+  {
+    OB::Mmap const m {file_name};
+    std::vector<size_t> found;
+    found.reserve(m.size() / 16);
+    for (auto const k : {OB::Scan::Kernel::scalar, OB::Scan::Kernel::sse2, OB::Scan::Kernel::avx2})
+    {
+      if (! OB::Scan::supported(k)) continue;
+      double const t {time_ns(cfg.iterations, [&]()
+      {
+        found.clear();
+        OB::Scan::newlines(k, m.data(), m.data() + m.size(), found);
+      })};
+      report(results, std::string("scan.") + OB::Scan::name(k), static_cast<double>(m.size()) / t * 1e3, "MB/s");
+    }
+  }
+
+  // splitting on the delimiter and measuring every frame
+  auto const delimit = [&](size_t threads)
+  {
+    return time_ns(cfg.iterations, [&]()
+    {
+      OB::Mmap m {file_name};
+      OB::Plan plan {std::move(m), offset, "END\n", threads};
+    });
+  };
+  double const ns {delimit(1)};
+  size_t frames {0};
+  {
+    OB::Mmap m {file_name};
+    frames = OB::Plan(std::move(m), offset, "END\n", 1).size();
+  }
+  report(results, "delimit", ns / static_cast<double>(frames), "ns/frame");
+  report(results, "delimit.throughput", static_cast<double>(size) / ns * 1e3, "MB/s");
+
+  // the same split across threads, doubling up to the core count
+  size_t const cores {std::max(std::thread::hardware_concurrency(), 1u)};
+  for (size_t threads = 2; threads / 2 < cores; threads *= 2)
+  {
+    size_t const n {std::min(threads, cores)};
+    double const t {delimit(n)};
+    report(results, "delimit.threads." + std::to_string(n) + ".throughput", static_cast<double>(size) / t * 1e3, "MB/s");
+    report(results, "delimit.threads." + std::to_string(n) + ".speedup", ns / t, "x");
+  }
+
+  report(results, "load.text", time_ns(cfg.iterations, [&]()
+  {
+    load(file_name, false);
+  }) / 1000.0, "us");
+
+  // loading followed by the interning pass, and what it found
+  report(results, "load.text.intern", time_ns(cfg.iterations, [&]()
+  {
+    OB::Plan::intern(load(file_name, false));
+  }) / 1000.0, "us");
+  auto const dedup = OB::Plan::intern(load(file_name, false)).dedup();
+  report(results, "intern.estimate", 100.0 * dedup.estimate, "%");
+  report(results, "intern.ratio", dedup.ratio(), "x");
+  report(results, "intern.unique_rows", dedup.rows > 0 ? 100.0 * static_cast<double>(dedup.unique_rows) / static_cast<double>(dedup.rows) : 0.0, "%");
+
+  auto const plan = load(file_name, false);
+
+  // packing to a quarter of the frame memory, and unpacking in order
+  size_t const budget {plan.bytes() / 4};
+  report(results, "packed.pack", time_ns(cfg.iterations, [&]()
+  {
+    OB::Packed packed {plan, budget, 16};
+  }) / static_cast<double>(plan.size()), "ns/frame");
+  OB::Packed packed {plan, budget, 16};
+  report(results, "packed.ratio", static_cast<double>(packed.packing().bytes) / static_cast<double>(packed.packing().packed), "x");
+  report(results, "packed.unpack", time_ns(cfg.iterations, [&]()
+  {
+    OB::View v;
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      packed.view(i, v);
+    }
+  }) / static_cast<double>(plan.size()), "ns/frame");
+
+  report(results, "diff.compute", time_ns(cfg.iterations, [&]()
+  {
+    OB::Diff diff {plan};
+  }) / static_cast<double>(plan.size()), "ns/frame");
+
+  OB::Diff const diff {plan};
+  std::map<std::string, std::string> headers;
+  Temp const compiled {""};
+  OB::Compiled::write(compiled.name(), plan, diff, headers, OB::Compiled::Origin());
+  report(results, "load.compiled", time_ns(cfg.iterations, [&]()
+  {
+    OB::Plan p;
+    OB::Diff d;
+    std::map<std::string, std::string> h;
+    OB::Compiled::read(OB::Mmap(compiled.name()), p, d, h);
+  }) / 1000.0, "us");
+
+  // a timeline with a delay of its own on every frame,
+  // and finding the frame due at points spread over three loops
+  std::mt19937 rng {static_cast<std::mt19937::result_type>(cfg.seed)};
+  std::vector<size_t> delays (plan.size());
+  for (auto& e : delays)
+  {
+    e = 1 + rng() % 500;
+  }
+  report(results, "timeline.build", time_ns(cfg.iterations, [&]()
+  {
+    OB::Timeline timeline {250};
+    for (size_t i = 0; i < delays.size(); ++i)
+    {
+      timeline.set(i, delays[i]);
+    }
+    timeline.close(delays.size());
+  }) / static_cast<double>(plan.size()), "ns/frame");
+
+  OB::Timeline timeline {250};
+  for (size_t i = 0; i < delays.size(); ++i)
+  {
+    timeline.set(i, delays[i]);
+  }
+  timeline.close(delays.size());
+  size_t const lookups {1000};
+  size_t volatile sink {0};
+  report(results, "timeline.position", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t i = 0; i < lookups; ++i)
+    {
+      sink = sink + timeline.position(timeline.total() * 3 / static_cast<int64_t>(lookups) * static_cast<int64_t>(i));
+    }
+  }) / static_cast<double>(lookups), "ns/lookup");
+}
+
+void bench_render(Config const& cfg, std::string const& file_name, std::vector<Result>& results)
+{
+  auto const plan = load(file_name, false);
+  OB::Diff const diff {plan};
+  double const frames {static_cast<double>(plan.size())};
+
+  int const fd {open("/dev/null", O_WRONLY | O_CLOEXEC)};
+  if (fd == -1)
+  {
+    throw std::runtime_error("could not open /dev/null");
+  }
+  OB::Output out {fd};
+
+  // moving the cursor back up over the previous frame
+  size_t const height {plan.size() > 0 ? plan.at(0).height : 0};
+  report(results, "clear", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      OB::Asciimation::clear_screen(out, height > 0 ? height - 1 : 0);
+      out.clear();
+    }
+  }) / frames, "ns/frame");
+
+  // a cursor move to every cell of a frame, into the output and as a string
+  double const cells {static_cast<double>(cfg.width * cfg.height)};
+  report(results, "escape.cursor_set", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t y = 1; y <= cfg.height; ++y)
+    {
+      for (size_t x = 1; x <= cfg.width; ++x)
+      {
+        out.cursor_set(x, y);
+      }
+    }
+    out.clear();
+  }) / cells, "ns/seq");
+
+  size_t volatile sink {0};
+  report(results, "escape.cursor_set.string", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t y = 1; y <= cfg.height; ++y)
+    {
+      for (size_t x = 1; x <= cfg.width; ++x)
+      {
+        sink = sink + AEC::cursor_set(x, y).size();
+      }
+    }
+  }) / cells, "ns/seq");
+
+  // building the bytes of a frame, without writing them
+  report(results, "encode.full", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      auto const view = plan.at(i);
+      OB::Asciimation::clear_screen(out, view.height > 0 ? view.height - 1 : 0);
+      out.attach(view.data, view.size);
+      out.clear();
+    }
+  }) / frames, "ns/frame");
+
+  report(results, "encode.diff", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      OB::Diff::encode(out, plan.at(i), diff.begin(i), diff.end(i), 1);
+      out.clear();
+    }
+  }) / frames, "ns/frame");
+
+  // building and writing, the frames go out to /dev/null
+  size_t bytes {0};
+  report(results, "render.full", time_ns(cfg.iterations, [&]()
+  {
+    bytes = 0;
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      auto const view = plan.at(i);
+      OB::Asciimation::clear_screen(out, view.height > 0 ? view.height - 1 : 0);
+      out.attach(view.data, view.size);
+      bytes += out.flush();
+    }
+  }) / frames, "ns/frame");
+  report(results, "render.full.bytes", static_cast<double>(bytes) / frames, "B/frame");
+
+  report(results, "render.diff", time_ns(cfg.iterations, [&]()
+  {
+    bytes = 0;
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      OB::Diff::encode(out, plan.at(i), diff.begin(i), diff.end(i), 1);
+      bytes += out.flush();
+    }
+  }) / frames, "ns/frame");
+  report(results, "render.diff.bytes", static_cast<double>(bytes) / frames, "B/frame");
+
+  close(fd);
+}
+
+// 16 frames of 200 rows, past the first two frames the rows
+// alternate between them so that once interned each is a segment of its own,
+// more of them than one writev takes
+std::string tall_frames()
+{
+  size_t const width {80};
+  size_t const height {200};
+  std::string str {"x:" + std::to_string(width) + "\ny:" + std::to_string(height) + "\nBEGIN\n"};
+  size_t const frames {16};
+  for (size_t i = 0; i < frames; ++i)
+  {
+    for (size_t r = 0; r < height; ++r)
+    {
+      char const c {static_cast<char>(i < 2 ? 'a' + i : 'a' + r % 2)};
+      str += std::string(width - 4, c) + std::to_string(1000 + r) + "\n";
+    }
+    if (i + 1 < frames) str += "END\n";
+  }
+  return str;
+}
+
+// the writes a repaint of a tall interned frame takes
+void bench_writes(Config const& cfg, std::vector<Result>& results)
+{
+  Temp const input {tall_frames()};
+  auto const plan = OB::Plan::intern(load(input.name(), false));
+
+  Count_Sink sink;
+  OB::Output out {sink};
+  report(results, "output.interned.tall", time_ns(cfg.iterations, [&]()
+  {
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      OB::Sgr::frame(out, plan.at(i));
+      out.flush();
+    }
+  }) / static_cast<double>(plan.size()), "ns/frame");
+
+  double const writes {static_cast<double>(sink.writes) / static_cast<double>(sink.frames)};
+  report(results, "output.interned.tall.writes", writes, "writes/frame");
+}
+
+// every frame goes to the sink in a single write,
+// more than one would let a terminal show part of a frame
+void check_writes()
+{
+  Temp const input {tall_frames()};
+  auto const plan = OB::Plan::intern(load(input.name(), false));
+  if (plan.rows() == nullptr)
+  {
+    throw std::runtime_error("the tall frames are not interned");
+  }
+
+  Count_Sink sink;
+  OB::Output out {sink};
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    OB::Sgr::frame(out, plan.at(i));
+    out.flush();
+    if (sink.writes != sink.frames)
+    {
+      throw std::runtime_error("frame " + std::to_string(i) + " is written in more than one call");
+    }
+  }
+}
+
+// frames rendered ahead on the second thread and taken at a steady pace as the player does,
+// then again after seeking back to the start
+void bench_ahead(Config const& cfg, std::string const& file_name, std::vector<Result>& results)
+{
+  auto plan = load(file_name, false);
+  if (plan.size() < 2) return;
+  OB::Diff const diff {plan};
+  size_t const num {std::min(plan.size() - 1, cfg.iterations * 5)};
+  OB::Ahead ahead {plan, diff, 4, plan.size()};
+
+  auto const hits = [&]()
+  {
+    ahead.restart(1, 1);
+    size_t res {0};
+    for (size_t n = 1; n <= num; ++n)
+    {
+      // a take marks the frame as on screen, so it is only asked for once
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      auto const buf = ahead.take(n);
+      if (buf)
+      {
+        ++res;
+        ahead.give(buf);
+      }
+    }
+    return static_cast<double>(res) / static_cast<double>(num) * 100.0;
+  };
+
+  report(results, "ahead.hits", hits(), "%");
+  report(results, "ahead.hits.seek_back", hits(), "%");
+}
+
+// seeks all over a plan packed as tightly as it goes with no window,
+// so that the frames on screen and the one unpacked from take every slot but one
+void check_packed(Config const& cfg)
+{
+  Config small {cfg};
+  small.frames = 64;
+  Temp const input {generate(small)};
+  auto const plan = load(input.name(), false);
+  OB::Packed packed {plan, 1, 0};
+
+  std::mt19937 rng {static_cast<std::mt19937::result_type>(cfg.seed)};
+  OB::View v;
+  for (size_t n = 0; n < 2000; ++n)
+  {
+    size_t const i {rng() % plan.size()};
+    packed.view(i, v);
+    packed.view((i + 1) % plan.size(), v);
+    if (v.size != plan.at((i + 1) % plan.size()).size)
+    {
+      throw std::runtime_error("packed frame " + std::to_string((i + 1) % plan.size()) + " does not match the plan");
+    }
+  }
+}
+
+// after playing on and seeking back, the frame sought to is the first
+// the render thread hands over, waits are bounded only so a failure does not hang
+void check_ahead(Config const& cfg)
+{
+  Config small {cfg};
+  small.frames = 16;
+  Temp const input {generate(small)};
+  auto plan = load(input.name(), false);
+  OB::Diff const diff {plan};
+  OB::Ahead ahead {plan, diff, 4, plan.size()};
+
+  auto const play = [&](size_t from, size_t num)
+  {
+    ahead.restart(from, 1);
+    if (ahead.next() != from)
+    {
+      throw std::runtime_error("restart does not move the render-ahead position");
+    }
+
+    for (size_t n = from; n < from + num; ++n)
+    {
+      auto const until = Clock::now() + std::chrono::seconds(10);
+      while (! ahead.ready(n))
+      {
+        if (Clock::now() > until)
+        {
+          throw std::runtime_error("frame " + std::to_string(n) + " is never rendered ahead");
+        }
+        std::this_thread::yield();
+      }
+
+      auto const buf = ahead.take(n);
+      if (buf == nullptr || buf->seq != n)
+      {
+        throw std::runtime_error("frame " + std::to_string(n) + " is not the one taken");
+      }
+      ahead.give(buf);
+    }
+  };
+
+  play(1, 12);
+  play(2, 4);
+  play(1, 1);
+}
+
+// blending with each kernel, and compositing frames of layers up front or as they are asked for
+void bench_layers(Config const& cfg, std::string const& file_name, std::vector<Result>& results)
+{
+  auto const plan = load(file_name, false);
+  if (plan.empty()) return;
+
+  // a row with every other run of cells clear
+  std::string const src {[&]()
+  {
+    std::string row (std::max(cfg.width, static_cast<size_t>(1)) * 64, ' ');
+    for (size_t i = 0; i < row.size(); ++i)
+    {
+      if ((i / 7) % 2 == 0) row[i] = '#';
+    }
+    return row;
+  }()};
+  std::string dst (src.size(), '.');
+  for (auto const k : {OB::Scan::Kernel::scalar, OB::Scan::Kernel::sse2, OB::Scan::Kernel::avx2})
+  {
+    if (! OB::Scan::supported(k)) continue;
+    double const t {time_ns(cfg.iterations * 100, [&]()
+    {
+      OB::Layers::blend(k, &dst[0], src.data(), src.size(), ' ');
+    })};
+    report(results, std::string("blend.") + OB::Scan::name(k), static_cast<double>(src.size()) / t * 1e3, "MB/s");
+  }
+
+  // the first frame as a background under a small sprite that moves every frame,
+  // either held once or repeated in every frame
+  auto const layered = [&](bool hold)
+  {
+    OB::View const bg {plan.at(0)};
+    std::vector<std::string> frames;
+    for (size_t i = 0; i < plan.size(); ++i)
+    {
+      std::string str;
+      if (! hold || i == 0)
+      {
+        str += hold ? "LAYER -1 ~ hold\n" : "LAYER -1 ~\n";
+        str.append(bg.data, bg.size);
+        str += "\n";
+      }
+      str += "LAYER 1\n";
+      str += std::string(i % std::max(bg.width, static_cast<size_t>(1)), ' ') + "<o>";
+      frames.emplace_back(str);
+    }
+    return OB::Plan(frames);
+  };
+
+  auto const held = layered(true);
+  report(results, "layers.flatten.held", time_ns(cfg.iterations, [&]()
+  {
+    OB::Layers::flatten(held);
+  }) / static_cast<double>(held.size()), "ns/frame");
+
+  auto const repeated = layered(false);
+  report(results, "layers.flatten.repeated", time_ns(cfg.iterations, [&]()
+  {
+    OB::Layers::flatten(repeated);
+  }) / static_cast<double>(repeated.size()), "ns/frame");
+
+  // frames viewed out of sequence, each replays from the keyframe before it
+  auto source = layered(true);
+  OB::Layered seek {source};
+  std::mt19937 rng {1};
+  std::uniform_int_distribution<size_t> pick {0, held.size() - 1};
+  OB::View v;
+  report(results, "layers.seek", time_ns(cfg.iterations * 100, [&]()
+  {
+    seek.view(pick(rng), v);
+  }), "ns/frame");
+}
+
+// the start-up path of the player, load the file and write the first frame
+void bench_first_frame(Config const& cfg, std::string const& file_name, std::vector<Result>& results)
+{
+  int const fd {open("/dev/null", O_WRONLY | O_CLOEXEC)};
+  if (fd == -1)
+  {
+    throw std::runtime_error("could not open /dev/null");
+  }
+
+  auto const first_frame = [&](bool regex)
+  {
+    auto const plan = load(file_name, regex);
+    auto const view = plan.at(0);
+    OB::Output out {fd};
+    out.append(AEC::erase_screen).append(AEC::cursor_home);
+    out.attach(view.data, view.size);
+    out.flush();
+  };
+
+  // the first run pays for page faults and the allocator warming up
+  for (auto const regex : {false, true})
+  {
+    std::string const name {regex ? "first_frame.regex" : "first_frame.tokenizer"};
+
+    auto const start = Clock::now();
+    first_frame(regex);
+    report(results, name + ".cold", elapsed(start) / 1000.0, "us");
+
+    report(results, name, time_ns(cfg.iterations, [&]()
+    {
+      first_frame(regex);
+    }) / 1000.0, "us");
+  }
+
+  close(fd);
+}
+
+int main(int argc, char *argv[])
+{
+  Parg pg {argc, argv};
+  pg.set_stdin(false);
+  int pstatus {program_options(pg)};
+  if (pstatus > 0) return 0;
+  if (pstatus < 0) return 1;
+
+  try
+  {
+    Config cfg;
+    cfg.frames = std::max(pg.get<size_t>("frames"), static_cast<size_t>(1));
+    cfg.width = std::max(pg.get<size_t>("width"), static_cast<size_t>(1));
+    cfg.height = std::max(pg.get<size_t>("height"), static_cast<size_t>(1));
+    cfg.change = std::min(std::max(pg.get<double>("change"), 0.0), 1.0);
+    cfg.headers = std::max(pg.get<size_t>("headers"), static_cast<size_t>(1));
+    cfg.iterations = std::max(pg.get<size_t>("iterations"), static_cast<size_t>(1));
+    cfg.seed = pg.get<unsigned long>("seed");
+
+    if (pg.get<bool>("check"))
+    {
+      check_ahead(cfg);
+      check_writes();
+      check_packed(cfg);
+      std::cout << "ok\n";
+      return 0;
+    }
+
+    std::string const file_name {pg.get("file")};
+    std::unique_ptr<Temp> generated;
+    if (file_name.empty())
+    {
+      generated.reset(new Temp(generate(cfg)));
+    }
+    std::string const input {generated ? generated->name() : file_name};
+
+    std::vector<Result> results;
+    bench_headers(cfg, results);
+    bench_load(cfg, input, results);
+    bench_render(cfg, input, results);
+    bench_writes(cfg, results);
+    bench_ahead(cfg, input, results);
+    bench_layers(cfg, input, results);
+    bench_first_frame(cfg, input, results);
+
+    std::string const json {pg.get("json")};
+    if (json == "-")
+    {
+      write_json(std::cout, cfg, file_name, results);
+      return 0;
+    }
+
+    for (auto const& e : results)
+    {
+      std::cout << std::left << std::setw(32) << e.name << std::right << std::fixed << std::setprecision(1) << std::setw(14) << e.value << " " << e.unit << "\n";
+    }
+
+    if (! json.empty())
+    {
+      std::ofstream ofile {json};
+      if (! ofile.is_open())
+      {
+        throw std::runtime_error("could not open output file");
+      }
+      write_json(ofile, cfg, file_name, results);
+    }
+  }
+  catch (std::exception const& e)
+  {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,184 @@
+#include "ahead.hh"
+#include "source.hh"
+#include "diff.hh"
+#include "output.hh"
+#include "trace.hh"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+Ahead::Ahead(Source& src, Diff const& diff, size_t depth, size_t end) :
+  src_ {src},
+  diff_ {diff},
+  count_ {src.size()},
+  end_ {end},
+  ready_ {std::max(depth, static_cast<size_t>(1))},
+  free_ {std::max(depth, static_cast<size_t>(1))}
+{
+  for (size_t i = 0; i < std::max(depth, static_cast<size_t>(1)); ++i)
+  {
+    pool_.emplace_back(new Buffer());
+    free_.push(pool_.back().get());
+  }
+
+  // nothing is rendered until the first restart
+  seq_ = end_;
+  thread_ = std::thread(&Ahead::run, this);
+}
+
+Ahead::~Ahead()
+{
+  stop_.store(true);
+  wake();
+  thread_.join();
+}
+
+void Ahead::restart(size_t seq, size_t origin)
+{
+  {
+    std::lock_guard<std::mutex> lock {mtx_};
+    seq_ = seq;
+    origin_ = origin;
+
+    // a seek back or a turn in direction moves the frame on screen back with it
+    next_.store(seq, std::memory_order_relaxed);
+  }
+  epoch_.fetch_add(1);
+  wake();
+}
+
+Ahead::Buffer* Ahead::take(size_t n)
+{
+  next_.store(n + 1, std::memory_order_relaxed);
+  uint64_t const epoch {epoch_.load(std::memory_order_relaxed)};
+
+  Buffer* buf {nullptr};
+  while (ready_.front(buf))
+  {
+    if (buf->epoch == epoch && buf->seq > n) break;
+
+    ready_.pop(buf);
+    if (buf->epoch == epoch && buf->seq == n) return buf;
+    give(buf);
+  }
+
+  return nullptr;
+}
+
+bool Ahead::ready(size_t n)
+{
+  uint64_t const epoch {epoch_.load(std::memory_order_relaxed)};
+
+  Buffer* buf {nullptr};
+  while (ready_.front(buf))
+  {
+    if (buf->epoch == epoch && buf->seq >= n) return buf->seq == n;
+
+    ready_.pop(buf);
+    give(buf);
+  }
+
+  return false;
+}
+
+size_t Ahead::next() const
+{
+  return next_.load(std::memory_order_relaxed);
+}
+
+void Ahead::give(Buffer* buf)
+{
+  buf->out.clear();
+  free_.push(buf);
+  wake();
+}
+
+void Ahead::wake()
+{
+  // pairs with the fence in run, so that either the render thread
+  // sees the change or it is seen parked here
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (parked_.load())
+  {
+    std::lock_guard<std::mutex> lock {mtx_};
+    cv_.notify_one();
+  }
+}
+
+void Ahead::run()
+{
+  uint64_t epoch {0};
+  size_t seq {end_};
+  size_t origin {1};
+  std::vector<Run> runs;
+
+  for (;;)
+  {
+    if (stop_.load()) return;
+
+    if (epoch_.load() != epoch)
+    {
+      std::lock_guard<std::mutex> lock {mtx_};
+      epoch = epoch_.load();
+      seq = seq_;
+      origin = origin_;
+    }
+
+    // never fall behind the frame on screen
+    seq = std::max(seq, next_.load(std::memory_order_relaxed));
+
+    Buffer* buf {nullptr};
+    if (seq >= end_ || ! free_.pop(buf))
+    {
+      // sleep until there is a buffer to fill or somewhere else to start
+      std::unique_lock<std::mutex> lock {mtx_};
+      parked_.store(true);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      cv_.wait(lock, [&]()
+      {
+        return stop_.load() || epoch_.load() != epoch || (seq < end_ && ! free_.empty());
+      });
+      parked_.store(false);
+      continue;
+    }
+
+    Trace::Scope scope {"ahead", seq};
+
+    size_t const i {seq % count_};
+    size_t const prev {i > 0 ? i - 1 : count_ - 1};
+    View next;
+    View base;
+    src_.view(i, next);
+    src_.view(prev, base);
+
+    if (! diff_.empty())
+    {
+      Diff::encode(buf->out, next, diff_.begin(i), diff_.end(i), origin);
+    }
+    else
+    {
+      runs.clear();
+      Diff::compute(base, next, runs);
+      Diff::encode(buf->out, next, runs.data(), runs.data() + runs.size(), origin);
+    }
+
+    buf->epoch = epoch;
+    buf->seq = seq;
+    buf->frame = i;
+    buf->base = prev;
+    ready_.push(buf);
+    ++seq;
+  }
+}
+
+} // namespace OB
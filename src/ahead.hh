@@ -0,0 +1,104 @@
+#ifndef OB_AHEAD_HH
+#define OB_AHEAD_HH
+
+#include "source.hh"
+#include "diff.hh"
+#include "output.hh"
+#include "spsc.hh"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// renders the diff output of the next frames on a second thread,
+// so that the main thread only has to wait for the deadline and write
+//
+// buffers go to the main thread through one queue and come back through
+// another, both single-producer single-consumer and lock-free,
+// the render thread only takes a lock to sleep while it has nothing to do
+class Ahead
+{
+public:
+  // the output of one frame, without the clear sequence or the overlay
+  struct Buffer
+  {
+    // rendering state the buffer was made for
+    uint64_t epoch {0};
+
+    // sequence number and frame index
+    size_t seq {0};
+    size_t frame {0};
+
+    // frame index the runs start from
+    size_t base {0};
+
+    Output out;
+  }; // struct Buffer
+
+  // the source must be stable and its size known,
+  // diff may be empty, the runs are then computed as needed
+  Ahead(Source& src, Diff const& diff, size_t depth, size_t end);
+  Ahead(Ahead const&) = delete;
+  Ahead& operator=(Ahead const&) = delete;
+  ~Ahead();
+
+  // render from sequence number seq on, with the runs placed at row origin,
+  // anything rendered before is dropped
+  void restart(size_t seq, size_t origin);
+
+  // the buffer for sequence number n, or nullptr if it is not ready,
+  // buffers for earlier sequence numbers are recycled
+  Buffer* take(size_t n);
+
+  // hand a buffer back once it has been written
+  void give(Buffer* buf);
+
+  // whether the buffer for sequence number n is ready, without taking it,
+  // so unlike take the render thread is not told that n is on screen
+  bool ready(size_t n);
+
+  // the first sequence number that may still be taken
+  size_t next() const;
+
+private:
+  Source& src_;
+  Diff const& diff_;
+  size_t count_ {0};
+  size_t end_ {0};
+
+  std::vector<std::unique_ptr<Buffer>> pool_;
+  Spsc<Buffer*> ready_;
+  Spsc<Buffer*> free_;
+
+  // set by the main thread only
+  std::atomic<uint64_t> epoch_ {0};
+  // the first sequence number the main thread may still take
+  std::atomic<size_t> next_ {0};
+  std::atomic<bool> stop_ {false};
+
+  // where to restart from, guarded by mtx_
+  size_t seq_ {0};
+  size_t origin_ {1};
+
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::atomic<bool> parked_ {false};
+
+  std::thread thread_;
+
+  void run();
+  void wake();
+
+}; // class Ahead
+
+} // namespace OB
+
+#endif // OB_AHEAD_HH
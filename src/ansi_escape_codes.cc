@@ -1,9 +1,8 @@
 #include "ansi_escape_codes.hh"
 
 #include <string>
-#include <vector>
-#include <sstream>
-#include <iostream>
+#include <cstddef>
+#include <cstring>
 
 namespace OB
 {
@@ -11,130 +10,187 @@ namespace OB
 namespace ANSI_Escape_Codes
 {
 
-  // standard escaped characters
-  std::string const nl {"\n"};
-  std::string const cr {"\r"};
-  std::string const tab {"\t"};
-  std::string const alert {"\a"};
-
-  // escape code sequence
-  std::string const esc {"\033["};
-
-  // clears all attributes
-  std::string const reset {esc + "0m"};
-
-  // style
-  std::string const bold {esc + "1m"};
-  std::string const dim {esc + "2m"};
-  std::string const italic {esc + "3m"};
-  std::string const underline {esc + "4m"};
-  std::string const blink {esc + "5m"};
-  std::string const rblink {esc + "6m"};
-  std::string const reverse {esc + "7m"};
-  std::string const conceal {esc + "8m"};
-  std::string const cross {esc + "9m"};
-
-  // erasing
-  std::string const erase_end {esc + "K"};
-  std::string const erase_start {esc + "1K"};
-  std::string const erase_line {esc + "2K"};
-  std::string const erase_down {esc + "J"};
-  std::string const erase_up {esc + "1J"};
-  std::string const erase_screen {esc + "2J"};
-
-  // cursor visibility
-  std::string const cursor_hide {esc + "?25l"};
-  std::string const cursor_show {esc + "?25h"};
-
-  // cursor movement
-  std::string const cursor_home {esc + "0;0H"};
-  std::string const cursor_up {esc + "1A"};
-  std::string const cursor_down {esc + "1B"};
-  std::string const cursor_right {esc + "1C"};
-  std::string const cursor_left {esc + "1D"};
-  std::string const cursor_save {"\0337"};
-  std::string const cursor_load {"\0338"};
-
-  // foreground color
-  std::string const fg_black {esc + "30m"};
-  std::string const fg_red {esc + "31m"};
-  std::string const fg_green {esc + "32m"};
-  std::string const fg_yellow {esc + "33m"};
-  std::string const fg_blue {esc + "34m"};
-  std::string const fg_magenta {esc + "35m"};
-  std::string const fg_cyan {esc + "36m"};
-  std::string const fg_white {esc + "37m"};
-
-  // background color
-  std::string const bg_black {esc + "40m"};
-  std::string const bg_red {esc + "41m"};
-  std::string const bg_green {esc + "42m"};
-  std::string const bg_yellow {esc + "43m"};
-  std::string const bg_blue {esc + "44m"};
-  std::string const bg_magenta {esc + "45m"};
-  std::string const bg_cyan {esc + "46m"};
-  std::string const bg_white {esc + "47m"};
+namespace
+{
+
+  size_t const table_size {1000};
+
+  // the decimal digits of a number, left aligned
+  struct Digits
+  {
+    char str[3];
+    unsigned char len;
+  }; // struct Digits
+
+  // built at compile time, covers every cursor coordinate of a sane terminal
+  struct Table
+  {
+    Digits digits[table_size];
+
+    constexpr Table() :
+      digits {}
+    {
+      for (size_t i = 0; i < table_size; ++i)
+      {
+        size_t const len {i < 10 ? 1u : i < 100 ? 2u : 3u};
+        size_t n {i};
+        for (size_t j = len; j > 0; --j)
+        {
+          digits[i].str[j - 1] = static_cast<char>('0' + n % 10);
+          n /= 10;
+        }
+        digits[i].len = static_cast<unsigned char>(len);
+      }
+    }
+  }; // struct Table
+
+  constexpr Table table {};
+
+  char* put(char* buf, char const* str, size_t size)
+  {
+    std::memcpy(buf, str, size);
+    return buf + size;
+  }
+
+  // the value of up to len hex digits, stops at the first other character
+  unsigned int hex(char const* str, size_t len)
+  {
+    unsigned int n {0};
+    for (size_t i = 0; i < len; ++i)
+    {
+      char const c {str[i]};
+      unsigned int d {0};
+      if (c >= '0' && c <= '9') d = static_cast<unsigned int>(c - '0');
+      else if (c >= 'a' && c <= 'f') d = static_cast<unsigned int>(c - 'a' + 10);
+      else if (c >= 'A' && c <= 'F') d = static_cast<unsigned int>(c - 'A' + 10);
+      else break;
+      n = n * 16 + d;
+    }
+    return n;
+  }
+
+  char* color(char* buf, char const* prefix, size_t n)
+  {
+    buf = put(buf, prefix, 7);
+    buf = decimal(buf, n);
+    *buf++ = 'm';
+    return buf;
+  }
+
+  char* color(char* buf, char const* prefix, unsigned char r, unsigned char g, unsigned char b)
+  {
+    buf = put(buf, prefix, 7);
+    buf = decimal(buf, r);
+    *buf++ = ';';
+    buf = decimal(buf, g);
+    *buf++ = ';';
+    buf = decimal(buf, b);
+    *buf++ = 'm';
+    return buf;
+  }
+
+  std::string color(char const* prefix, std::string const& x)
+  {
+    if (x.size() != 6) return {};
+    char buf[true_max];
+    auto const end = color(buf, prefix,
+      static_cast<unsigned char>(hex(x.data(), 2)),
+      static_cast<unsigned char>(hex(x.data() + 2, 2)),
+      static_cast<unsigned char>(hex(x.data() + 4, 2)));
+    return std::string(buf, static_cast<size_t>(end - buf));
+  }
+
+} // namespace
+
+  char* decimal(char* buf, size_t num)
+  {
+    if (num < table_size)
+    {
+      // always copies three bytes, the max sizes leave room for it
+      auto const& e = table.digits[num];
+      std::memcpy(buf, e.str, sizeof(e.str));
+      return buf + e.len;
+    }
+
+    char str[uint_max];
+    size_t i {sizeof(str)};
+    do
+    {
+      str[--i] = static_cast<char>('0' + num % 10);
+      num /= 10;
+    }
+    while (num > 0);
+
+    return put(buf, str + i, sizeof(str) - i);
+  }
+
+  char* cursor_set(char* buf, size_t x, size_t y)
+  {
+    *buf++ = '\033';
+    *buf++ = '[';
+    buf = decimal(buf, y);
+    *buf++ = ';';
+    buf = decimal(buf, x);
+    *buf++ = 'H';
+    return buf;
+  }
+
+  char* fg_256(char* buf, size_t n)
+  {
+    return color(buf, "\033[38;5;", n);
+  }
+
+  char* bg_256(char* buf, size_t n)
+  {
+    return color(buf, "\033[48;5;", n);
+  }
+
+  char* fg_true(char* buf, unsigned char r, unsigned char g, unsigned char b)
+  {
+    return color(buf, "\033[38;2;", r, g, b);
+  }
+
+  char* bg_true(char* buf, unsigned char r, unsigned char g, unsigned char b)
+  {
+    return color(buf, "\033[48;2;", r, g, b);
+  }
 
   std::string fg_256(std::string x)
   {
     auto n = std::stoi(x);
     if (n < 0 || n > 256) return {};
-    std::stringstream ss;
-    ss << esc << "38;5;" << x << "m";
-    return ss.str();
+    char buf[color_max];
+    return std::string(buf, static_cast<size_t>(fg_256(buf, static_cast<size_t>(n)) - buf));
   }
 
   std::string bg_256(std::string x)
   {
     auto n = std::stoi(x);
     if (n < 0 || n > 256) return {};
-    std::stringstream ss;
-    ss << esc << "48;5;" << x << "m";
-    return ss.str();
+    char buf[color_max];
+    return std::string(buf, static_cast<size_t>(bg_256(buf, static_cast<size_t>(n)) - buf));
   }
 
   std::string htoi(std::string x)
   {
-    std::stringstream ss;
-    ss << x;
-    unsigned int n;
-    ss >> std::hex >> n;
-    return std::to_string(n);
+    char buf[uint_max];
+    return std::string(buf, static_cast<size_t>(decimal(buf, hex(x.data(), x.size())) - buf));
   }
 
   std::string fg_true(std::string x)
   {
-    if (x.size() != 6) return {};
-    std::string h1 {x.substr(0, 2)};
-    std::string h2 {x.substr(2, 2)};
-    std::string h3 {x.substr(4, 2)};
-    std::stringstream ss; ss
-    << esc << "38;2;"
-    << htoi(h1) << ";"
-    << htoi(h2) << ";"
-    << htoi(h3) << "m";
-    return ss.str();
+    return color("\033[38;2;", x);
   }
 
   std::string bg_true(std::string x)
   {
-    if (x.size() != 6) return {};
-    std::string h1 {x.substr(0, 2)};
-    std::string h2 {x.substr(2, 2)};
-    std::string h3 {x.substr(4, 2)};
-    std::stringstream ss; ss
-    << esc << "48;2;"
-    << htoi(h1) << ";"
-    << htoi(h2) << ";"
-    << htoi(h3) << "m";
-    return ss.str();
+    return color("\033[48;2;", x);
   }
 
   std::string cursor_set(size_t x, size_t y)
   {
-    std::stringstream ss;
-    ss << esc << y << ";" << x << "H";
-    return ss.str();
+    char buf[cursor_set_max];
+    return std::string(buf, static_cast<size_t>(cursor_set(buf, x, y) - buf));
   }
 
 } // namespace ANSI_Escape_Codes
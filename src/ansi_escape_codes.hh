@@ -3,77 +3,122 @@
 
 #include <string>
 #include <vector>
-#include <sstream>
-#include <iostream>
+#include <ostream>
+#include <cstddef>
 
 namespace OB
 {
 
 namespace ANSI_Escape_Codes
 {
+  // a fixed sequence, built at compile time and usable wherever a string is
+  struct Seq
+  {
+    char const* data;
+    size_t size;
+
+    template<size_t N>
+    explicit constexpr Seq(char const (&str)[N]) :
+      data {str},
+      size {N - 1}
+    {
+    }
+
+    operator std::string() const
+    {
+      return {data, size};
+    }
+  }; // struct Seq
+
+  inline std::ostream& operator<<(std::ostream& os, Seq const& seq)
+  {
+    return os.write(seq.data, static_cast<std::streamsize>(seq.size));
+  }
+
   // standard escaped characters
-  extern std::string const nl;
-  extern std::string const cr;
-  extern std::string const tab;
-  extern std::string const alert;
+  constexpr Seq nl {"\n"};
+  constexpr Seq cr {"\r"};
+  constexpr Seq tab {"\t"};
+  constexpr Seq alert {"\a"};
 
   // escape code sequence
-  extern std::string const esc;
+  constexpr Seq esc {"\033["};
 
   // clears all attributes
-  extern std::string const reset;
+  constexpr Seq reset {"\033[0m"};
 
   // style
-  extern std::string const bold;
-  extern std::string const dim;
-  extern std::string const italic;
-  extern std::string const underline;
-  extern std::string const blink;
-  extern std::string const rblink;
-  extern std::string const reverse;
-  extern std::string const conceal;
-  extern std::string const cross;
+  constexpr Seq bold {"\033[1m"};
+  constexpr Seq dim {"\033[2m"};
+  constexpr Seq italic {"\033[3m"};
+  constexpr Seq underline {"\033[4m"};
+  constexpr Seq blink {"\033[5m"};
+  constexpr Seq rblink {"\033[6m"};
+  constexpr Seq reverse {"\033[7m"};
+  constexpr Seq conceal {"\033[8m"};
+  constexpr Seq cross {"\033[9m"};
 
   // erasing
-  extern std::string const erase_end;
-  extern std::string const erase_start;
-  extern std::string const erase_line;
-  extern std::string const erase_down;
-  extern std::string const erase_up;
-  extern std::string const erase_screen;
+  constexpr Seq erase_end {"\033[K"};
+  constexpr Seq erase_start {"\033[1K"};
+  constexpr Seq erase_line {"\033[2K"};
+  constexpr Seq erase_down {"\033[J"};
+  constexpr Seq erase_up {"\033[1J"};
+  constexpr Seq erase_screen {"\033[2J"};
 
   // cursor visibility
-  extern std::string const cursor_hide;
-  extern std::string const cursor_show;
+  constexpr Seq cursor_hide {"\033[?25l"};
+  constexpr Seq cursor_show {"\033[?25h"};
 
   // cursor movement
-  extern std::string const cursor_home;
-  extern std::string const cursor_up;
-  extern std::string const cursor_down;
-  extern std::string const cursor_right;
-  extern std::string const cursor_left;
-  extern std::string const cursor_save;
-  extern std::string const cursor_load;
+  constexpr Seq cursor_home {"\033[0;0H"};
+  constexpr Seq cursor_up {"\033[1A"};
+  constexpr Seq cursor_down {"\033[1B"};
+  constexpr Seq cursor_right {"\033[1C"};
+  constexpr Seq cursor_left {"\033[1D"};
+  constexpr Seq cursor_save {"\0337"};
+  constexpr Seq cursor_load {"\0338"};
 
   // foreground color
-  extern std::string const fg_black;
-  extern std::string const fg_red;
-  extern std::string const fg_green;
-  extern std::string const fg_yellow;
-  extern std::string const fg_blue;
-  extern std::string const fg_magenta;
-  extern std::string const fg_cyan;
-  extern std::string const fg_white;
+  constexpr Seq fg_black {"\033[30m"};
+  constexpr Seq fg_red {"\033[31m"};
+  constexpr Seq fg_green {"\033[32m"};
+  constexpr Seq fg_yellow {"\033[33m"};
+  constexpr Seq fg_blue {"\033[34m"};
+  constexpr Seq fg_magenta {"\033[35m"};
+  constexpr Seq fg_cyan {"\033[36m"};
+  constexpr Seq fg_white {"\033[37m"};
 
   // background color
-  extern std::string const bg_black;
-  extern std::string const bg_red;
-  extern std::string const bg_green;
-  extern std::string const bg_yellow;
-  extern std::string const bg_blue;
-  extern std::string const bg_magenta;
-  extern std::string const bg_cyan;
-  extern std::string const bg_white;
+  constexpr Seq bg_black {"\033[40m"};
+  constexpr Seq bg_red {"\033[41m"};
+  constexpr Seq bg_green {"\033[42m"};
+  constexpr Seq bg_yellow {"\033[43m"};
+  constexpr Seq bg_blue {"\033[44m"};
+  constexpr Seq bg_magenta {"\033[45m"};
+  constexpr Seq bg_cyan {"\033[46m"};
+  constexpr Seq bg_white {"\033[47m"};
+
+  // encoders, each writes its sequence to buf and returns the end of it,
+  // buf must hold at least the matching max bytes
+  constexpr size_t uint_max {20};
+  constexpr size_t cursor_set_max {2 + uint_max + 1 + uint_max + 1};
+  constexpr size_t color_max {8 + uint_max};
+  constexpr size_t true_max {19};
+
+  // decimal digits of num, numbers below 1000 come from a table
+  char* decimal(char* buf, size_t num);
+
+  // cursor position, 1 based
+  char* cursor_set(char* buf, size_t x, size_t y);
+
+  // palette color
+  char* fg_256(char* buf, size_t n);
+  char* bg_256(char* buf, size_t n);
+
+  // 24 bit color
+  char* fg_true(char* buf, unsigned char r, unsigned char g, unsigned char b);
+  char* bg_true(char* buf, unsigned char r, unsigned char g, unsigned char b);
 
   // prototypes
   std::string fg_256(std::string x);
@@ -83,34 +128,47 @@ namespace ANSI_Escape_Codes
   std::string bg_true(std::string x);
   std::string cursor_set(size_t x, size_t y);
 
+  // the text of a value
+  inline std::string text(std::string const& val)
+  {
+    return val;
+  }
+
+  inline std::string text(char const* val)
+  {
+    return val;
+  }
+
+  inline std::string text(char const val)
+  {
+    return std::string(1, val);
+  }
+
+  template<class T>
+  std::string text(T const val)
+  {
+    return std::to_string(val);
+  }
+
   template<class T>
   std::string wrap(T const val, std::string col)
   {
-    std::string x {std::to_string(val)};
+    std::string x {text(val)};
     if (x.size() != 6) return {};
-    std::string h1 {x.substr(0, 2)};
-    std::string h2 {x.substr(2, 2)};
-    std::string h3 {x.substr(4, 2)};
-    std::stringstream ss; ss
-    << esc << "38;2;"
-    << htoi(h1) << ";"
-    << htoi(h2) << ";"
-    << htoi(h3) << "m"
-    << val
-    << reset;
-    return ss.str();
+    return fg_true(x) + x + std::string(reset);
   }
 
   template<class T>
   std::string wrap(T const val, std::vector<std::string> const col)
   {
-    std::stringstream ss;
+    std::string str;
     for (auto const& e : col)
     {
-      ss << e;
+      str += e;
     }
-    ss << val << reset;
-    return ss.str();
+    str += text(val);
+    str.append(reset.data, reset.size);
+    return str;
   }
 
 } // namespace ANSI_Escape_Codes
@@ -1,22 +1,64 @@
 #include "asciimation.hh"
 #include "term.hh"
+#include "plan.hh"
+#include "diff.hh"
+#include "scheduler.hh"
+#include "timeline.hh"
+#include "output.hh"
+#include "mmap.hh"
+#include "source.hh"
+#include "stream.hh"
+#include "compiled.hh"
+#include "header.hh"
+#include "events.hh"
+#include "vt.hh"
+#include "stats.hh"
+#include "trace.hh"
+#include "ahead.hh"
+#include "layers.hh"
+#include "color.hh"
+#include "packed.hh"
+#include "broadcast.hh"
 
 #include "ansi_escape_codes.hh"
 namespace AEC = OB::ANSI_Escape_Codes;
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <malloc.h>
+
 #include <string>
 #include <sstream>
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <map>
-#include <regex>
 #include <chrono>
-#include <thread>
+#include <iomanip>
+#include <fstream>
+#include <memory>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <utility>
 
 namespace OB
 {
 
+// events kept for --trace, the most recent ones win
+static size_t const trace_size {1 << 16};
+
+// how long the rate of the terminal is measured for on start
+static std::chrono::milliseconds const probe_time {50};
+
+// layer, color and delay lines are only taken as such in a file
+// with the header 'layers:on', older files may have text that looks like them
+static bool layered(std::map<std::string, std::string> const& headers)
+{
+  auto const it = headers.find("layers");
+  return it != headers.end() && it->second == "on";
+}
+
 Asciimation::Asciimation()
 {
 }
@@ -43,132 +85,834 @@ Asciimation& Asciimation::set_delay(size_t delay)
   return *this;
 }
 
+Asciimation& Asciimation::set_start_frame(size_t frame)
+{
+  start_frame_ = frame;
+  return *this;
+}
+
+Asciimation& Asciimation::set_start_time(double time)
+{
+  start_time_ = time;
+  return *this;
+}
+
+Asciimation& Asciimation::set_render(std::string render)
+{
+  if (render == "full")
+  {
+    diff_ = false;
+  }
+  else if (render == "diff")
+  {
+    diff_ = true;
+  }
+  else
+  {
+    throw std::runtime_error("invalid render mode '" + render + "'");
+  }
+  return *this;
+}
+
+Asciimation& Asciimation::set_skip(std::string skip)
+{
+  skip_ = Scheduler::skip(skip);
+  return *this;
+}
+
+Asciimation& Asciimation::set_buffer(size_t buffer)
+{
+  buffer_ = buffer;
+  return *this;
+}
+
+Asciimation& Asciimation::set_memory(size_t memory)
+{
+  memory_ = memory * 1024 * 1024;
+  return *this;
+}
+
+Asciimation& Asciimation::set_ahead(size_t ahead)
+{
+  ahead_ = ahead;
+  return *this;
+}
+
+Asciimation& Asciimation::set_stream_loop(std::string keep)
+{
+  keep_ = Stream::keep(keep);
+  return *this;
+}
+
 Asciimation& Asciimation::set_delim(std::string delim)
 {
   delim_ = delim + "\n";
   return *this;
 }
 
+Asciimation& Asciimation::set_cache(bool cache)
+{
+  cache_ = cache;
+  return *this;
+}
+
+Asciimation& Asciimation::set_output(std::string output)
+{
+  output_ = output;
+  return *this;
+}
+
+Asciimation& Asciimation::set_stats(std::string stats)
+{
+  stats_ = stats;
+  return *this;
+}
+
+Asciimation& Asciimation::set_trace(std::string trace)
+{
+  trace_ = trace;
+  return *this;
+}
+
+Asciimation& Asciimation::set_tty(bool tty)
+{
+  tty_ = tty;
+  return *this;
+}
+
+Asciimation& Asciimation::set_ttys(std::string ttys)
+{
+  ttys_.clear();
+  std::istringstream ss {ttys};
+  std::string tty;
+  while (std::getline(ss, tty, ','))
+  {
+    if (! tty.empty()) ttys_.emplace_back(tty);
+  }
+  return *this;
+}
+
+Asciimation& Asciimation::set_socket(std::string socket)
+{
+  socket_ = socket;
+  return *this;
+}
+
 void Asciimation::run(std::string file_name)
 {
-  std::ifstream ifile {file_name};
-  if (! ifile.is_open())
+  // a broadcast plays in real time, with or without a terminal of its own
+  bool const broadcast {! ttys_.empty() || ! socket_.empty()};
+  if (broadcast && ! output_.empty())
   {
-    throw std::runtime_error("could not open input file");
+    throw std::runtime_error("a broadcast can not be played into an output file");
   }
+  headless_ = ! output_.empty() || (! tty_ && ! broadcast);
 
-  // parse headers
+  if (trace_.empty())
+  {
+    play_file(file_name);
+    return;
+  }
+
+  // the trace is also written when playback fails
+  Trace::enable(trace_size);
+  try
+  {
+    play_file(file_name);
+  }
+  catch (...)
+  {
+    Trace::write(trace_);
+    throw;
+  }
+  Trace::write(trace_);
+}
+
+void Asciimation::play_file(std::string const& file_name)
+{
   std::map<std::string, std::string> headers;
-  std::string line;
-  bool begin_found {false};
-  while (std::getline(ifile, line))
+
+  // a headless run has to end
+  if (headless_ && loop_ == 0)
   {
-    if (line == begin_)
+    loop_ = 1;
+  }
+
+  // anything that can not be mapped, such as stdin or a pipe, is streamed
+  struct stat st;
+  if (file_name == "-" || (stat(file_name.c_str(), &st) == 0 && ! S_ISREG(st.st_mode)))
+  {
+    stream(file_name, headers);
+    return;
+  }
+
+  Plan plan;
+  Diff diff;
+  open_plan(file_name, plan, diff, headers);
+  dedup_ = plan.dedup();
+
+  // frames that do not fit the memory budget are kept packed,
+  // and only the window ahead of playback is unpacked
+  if (memory_ > 0 && plan.bytes() > memory_)
+  {
+    std::unique_ptr<Packed> packed;
     {
-      begin_found = true;
-      break;
+      Trace::Scope scope {"pack"};
+      packed.reset(new Packed(plan, memory_, buffer_));
     }
-    std::smatch m;
-    if (std::regex_match(line, m, std::regex("^(.+?)\\s*:\\s*(.+)$")))
+    plan = Plan();
+#ifdef __GLIBC__
+    // frames freed while loading are spread over the heap, hand them back to the system
+    malloc_trim(0);
+#endif
+    packing_ = &packed->packing();
+    play(*packed, Diff(), headers);
+    packing_ = nullptr;
+    return;
+  }
+
+  // runs from a compiled file are only used in diff mode,
+  // and are computed here when the file has none,
+  // unless frames are rendered ahead, which computes them as it goes
+  if (! diff_)
+  {
+    diff = Diff();
+  }
+  else if (diff.empty() && ahead_ == 0)
+  {
+    Trace::Scope scope {"diff"};
+    diff = Diff(plan);
+  }
+
+  play(plan, diff, headers);
+}
+
+void Asciimation::play(Source& src, Diff const& diff, std::map<std::string, std::string>& headers)
+{
+  if (! ttys_.empty() || ! socket_.empty())
+  {
+    // the local terminal, if there is one, is a reader like any other
+    // and the only one keys are read from
+    std::unique_ptr<OB::Term> term;
+    if (tty_)
+    {
+      check_window_size(headers);
+      term.reset(new OB::Term(input_));
+    }
+
+    Fd_Sink local;
+    Broadcast sink {ttys_, socket_, tty_ ? &local : nullptr};
+
+    main_loop(src, diff, sink);
+    return;
+  }
+
+  if (! headless_)
+  {
+    check_window_size(headers);
+
+    OB::Term term {input_};
+
+    // frames the terminal can not keep up with are dropped, only the drop
+    // policy allows for that, the others wait on the terminal instead
+    if (skip_ == Scheduler::Skip::drop)
+    {
+      Tty_Sink sink;
+      sink.probe(probe_time);
+      main_loop(src, diff, sink);
+      return;
+    }
+
+    Fd_Sink sink;
+    main_loop(src, diff, sink);
+    return;
+  }
+
+  if (output_ == "vt")
+  {
+    // a standard terminal, grown to fit the size the headers ask for
+    size_t width {80};
+    size_t height {24};
+    if (headers.find("x") != headers.end()) width = std::max(width, std::stoul(headers["x"]));
+    if (headers.find("y") != headers.end()) height = std::max(height, std::stoul(headers["y"]) + (debug_ ? 2 : 0));
+
+    Vt vt {width, height};
+    main_loop(src, diff, vt);
+    std::cout << vt.screen() << std::flush;
+    return;
+  }
+
+  std::unique_ptr<Fd_Sink> sink;
+  if (output_.empty())
+  {
+    sink.reset(new Fd_Sink(STDOUT_FILENO));
+  }
+  else
+  {
+    sink.reset(new Fd_Sink(output_ == "null" ? "/dev/null" : output_));
+  }
+  main_loop(src, diff, *sink);
+}
+
+void Asciimation::compile(std::string file_name, std::string out_name)
+{
+  if (out_name.empty())
+  {
+    out_name = file_name + ".asc";
+  }
+
+  std::map<std::string, std::string> headers;
+  Mmap map {file_name};
+  if (Compiled::is_compiled(map))
+  {
+    throw std::runtime_error("input file is already compiled");
+  }
+
+  Plan plan {load(std::move(map), headers)};
+  Diff diff {plan};
+  Compiled::write(out_name, plan, diff, headers, Compiled::origin(file_name, delim_));
+}
+
+void Asciimation::open_plan(std::string const& file_name, Plan& plan, Diff& diff,
+  std::map<std::string, std::string>& headers) const
+{
+  Mmap map {file_name};
+  if (Compiled::is_compiled(map))
+  {
+    Trace::Scope scope {"load_compiled"};
+    Compiled::read(std::move(map), plan, diff, headers);
+    return;
+  }
+
+  // repeated rows and frames are stored once, a compiled or cached plan
+  // is played in place from its mapping instead
+  if (! cache_)
+  {
+    plan = load(std::move(map), headers);
+    Trace::Scope scope {"intern"};
+    plan = Plan::intern(std::move(plan));
+    return;
+  }
+
+  // a cached copy is used while the source keeps its mtime, size, inode, ctime
+  // and the bytes at either end
+  auto const origin = Compiled::origin(file_name, delim_);
+  auto const path = Compiled::cache_path(origin);
+  struct stat st;
+  if (! path.empty() && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+  {
+    Mmap cached {path};
+    Compiled::Origin o;
+    if (Compiled::read_origin(cached, o) && o.matches(origin))
     {
-      headers[std::string(m[1])] = std::string(m[2]);
+      Trace::Scope scope {"load_compiled"};
+      Compiled::read(std::move(cached), plan, diff, headers);
+      return;
+    }
+  }
+
+  plan = load(std::move(map), headers);
+  {
+    Trace::Scope scope {"diff"};
+    diff = Diff(plan);
+  }
+
+  // a cache that can not be written only costs the next launch its head start
+  if (! path.empty())
+  {
+    Trace::Scope scope {"cache_write"};
+    try
+    {
+      Compiled::write(path, plan, diff, headers, origin);
+    }
+    catch (std::exception const&)
+    {
+    }
+  }
+}
+
+void Asciimation::stream(std::string const& file_name, std::map<std::string, std::string>& headers)
+{
+  int fd {STDIN_FILENO};
+  if (file_name != "-")
+  {
+    fd = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+      throw std::runtime_error("could not open input file");
+    }
+  }
+
+  // when the frames come in on stdin, the keys are read from the terminal
+  if (fd == STDIN_FILENO && tty_ && ! headless_)
+  {
+    input_ = open("/dev/tty", O_RDWR | O_CLOEXEC);
+    if (input_ == -1)
+    {
+      throw std::runtime_error("could not open the terminal for input");
+    }
+  }
+
+  try
+  {
+    Stream src {fd, delim_, buffer_, loop_ == 1 ? Stream::Keep::none : keep_};
+
+    auto const parse = Trace::Clock::now();
+    std::string line;
+    size_t line_num {0};
+    bool begin_found {false};
+    while (src.line(line))
+    {
+      ++line_num;
+      if (line == begin_)
+      {
+        begin_found = true;
+        break;
+      }
+      parse_header(line, line_num, headers);
+    }
+
+    if (! begin_found)
+    {
+      throw std::runtime_error("begin identifier not found");
+    }
+    Trace::record("headers", parse, Trace::Clock::now());
+
+    // layers are composited as the frames arrive
+    if (layered(headers))
+    {
+      Layered layers {src};
+      play(layers, Diff(), headers);
     }
     else
     {
-      throw std::runtime_error("invalid header syntax");
+      play(src, Diff(), headers);
+    }
+  }
+  catch (...)
+  {
+    if (fd != STDIN_FILENO) close(fd);
+    if (input_ != STDIN_FILENO) close(input_);
+    input_ = STDIN_FILENO;
+    throw;
+  }
+
+  if (fd != STDIN_FILENO) close(fd);
+  if (input_ != STDIN_FILENO) close(input_);
+  input_ = STDIN_FILENO;
+}
+
+Plan Asciimation::load(Mmap&& map, std::map<std::string, std::string>& headers) const
+{
+  char const* const first {map.data()};
+  char const* const last {first + map.size()};
+
+  // parse headers
+  auto const parse = Trace::Clock::now();
+  char const* pos {first};
+  size_t line_num {0};
+  bool begin_found {false};
+  while (pos != last)
+  {
+    auto const eol = static_cast<char const*>(std::memchr(pos, '\n', static_cast<size_t>(last - pos)));
+    std::string const line (pos, eol ? eol : last);
+    pos = eol ? eol + 1 : last;
+    ++line_num;
+
+    if (line == begin_)
+    {
+      begin_found = true;
+      break;
     }
+    parse_header(line, line_num, headers);
   }
 
   if (! begin_found)
   {
     throw std::runtime_error("begin identifier not found");
   }
+  Trace::record("headers", parse, Trace::Clock::now());
 
-  check_window_size(headers);
-
-  size_t offset = ifile.tellg();
-  ifile.seekg(0, std::ios::end);
-  size_t size = ifile.tellg();
-  size -= offset;
-  std::string content (size, ' ');
-  ifile.seekg(offset);
-  ifile.read(&content[0], size);
-  ifile.close();
+  // the frames are indexed in place, without copying them out of the mapping
+  Plan plan;
+  {
+    Trace::Scope delimit {"delimit"};
+    plan = Plan(std::move(map), static_cast<size_t>(pos - first), delim_);
+  }
 
-  auto frames = delimit(content, delim_);
+  // layered frames are composited once, up front
+  if (plan.directives() && layered(headers))
+  {
+    Trace::Scope layers {"layers"};
+    plan = Layers::flatten(plan);
+  }
 
-  OB::Term term;
+  return plan;
+}
 
-  main_loop(frames);
+void Asciimation::parse_header(std::string const& line, size_t line_num, std::map<std::string, std::string>& headers) const
+{
+  std::string key;
+  std::string value;
+  size_t col {0};
+  if (! Header::parse(line.data(), line.size(), key, value, col))
+  {
+    throw std::runtime_error("invalid header syntax at line " + std::to_string(line_num) + ", column " + std::to_string(col));
+  }
+  headers[key] = value;
 }
 
-void Asciimation::main_loop(std::vector<std::string>& frames)
+void Asciimation::main_loop(Source& src, Diff const& diff, Sink& sink)
 {
-  std::cout << AEC::erase_screen << AEC::cursor_home;
+  // every tick, the clear sequence, the debug overlay and the frame,
+  // goes out through a single write
+  Output out {sink};
+
+  // a whole frame for readers of a broadcast that fell behind or just joined
+  Output key {sink};
+
+  // a headless run renders back to back, without a terminal, keys or signals,
+  // a broadcast without a terminal has no keys either
+  std::unique_ptr<Events> events;
+  if (! headless_)
+  {
+    events.reset(new Events(tty_ ? input_ : -1));
+  }
+
+  // a terminal written without blocking, what it has not taken yet
+  // is written while waiting for anything else
+  auto const term = dynamic_cast<Tty_Sink*>(&sink);
+  auto const next_event = [&]()
+  {
+    if (term) events->watch(term->pending() ? term->fd() : -1);
+    int const ev {events->wait()};
+    if (ev & Events::output) term->drain();
+    return ev;
+  };
+
+  // block until a key is pressed, while paused nothing else wakes the player,
+  // false if it has to exit instead
+  auto const wait_key = [&]()
+  {
+    Trace::Scope scope {"paused"};
+    events->arm(Events::Clock::time_point::max());
+    char c {0};
+    for (;;)
+    {
+      int const ev {next_event()};
+      if (ev & Events::terminate) return false;
+      if ((ev & Events::input) && events->key(c)) return true;
+    }
+  };
+
+  using Clock = std::chrono::steady_clock;
+  auto const elapsed = [](Clock::time_point begin, Clock::time_point end)
+  {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+  };
+
+  Stats stats;
+  stats.set_dedup(dedup_);
+  auto const start = Clock::now();
+
+  // how late the current tick started after its deadline
+  uint64_t late {0};
+
+  // frames not sent to a terminal that had not taken the ones before yet
+  size_t slow {0};
 
   bool exit {false};
-  size_t loop_count {loop_};
   size_t line_num {0};
-  size_t frame_num {0};
 
-  while (! exit && (loop_ == 0 || loop_count >= 1))
+  // diff mode state, the frame currently on screen
+  // and whether the next frame has to be fully repainted
+  size_t shown {0};
+  View shown_view;
+  bool repaint {true};
+  std::vector<Run> runs;
+
+  // the frame sequence number, counts up across loops,
+  // the frame count of a stream is only known once it has ended
+  size_t n {0};
+  size_t count {0};
+  size_t end {std::numeric_limits<size_t>::max()};
+
+  // when each frame is due, a source whose frames can be read at any time
+  // is measured up front, a stream as its frames are seen
+  Timeline timeline {delay_};
+  if (src.stable() && src.size() > 0)
   {
-    frame_num = 0;
-    for (auto const& e : frames)
+    Trace::Scope scope {"timeline"};
+    View v;
+    for (size_t i = 0; i < src.size() && src.view(i, v); ++i)
     {
-      if (exit) break;
+      timeline.set(i, v.delay);
+    }
+    timeline.close(src.size());
+  }
+
+  // where playback starts, a frame or a point in time of the first loop,
+  // a stream is read up to it
+  if (start_frame_ > 0)
+  {
+    n = start_frame_ - 1;
+    if (src.stable() && n >= src.size())
+    {
+      throw std::runtime_error("start frame is past the last frame");
+    }
+  }
+  else if (start_time_ > 0)
+  {
+    int64_t const t {static_cast<int64_t>(start_time_ * 1e9)};
+    if (timeline.closed())
+    {
+      if (timeline.total() > 0) n = timeline.position(t % timeline.total());
+    }
+    else
+    {
+      View v;
+      while (src.view(n, v))
+      {
+        timeline.set(n, v.delay);
+        if (timeline.offset(n + 1) > t) break;
+        ++n;
+      }
+    }
+  }
+
+  // frames rendered ahead on a second thread, only for sources
+  // whose frames can be read from any thread and whose length is known
+  std::unique_ptr<Ahead> ahead;
+  size_t ahead_origin {0};
+  if (diff_ && ahead_ > 0 && src.stable() && src.size() > 0)
+  {
+    ahead.reset(new Ahead(src, diff, ahead_, loop_ != 0 ? loop_ * src.size() : end));
+    ahead_origin = debug_ ? 3 : 1;
+    ahead->restart(n + 1, ahead_origin);
+  }
+  Ahead::Buffer* buf {nullptr};
+
+  Scheduler sched;
+  sched.set_skip(skip_);
+  sched.start(timeline, n);
+
+  // the current loop is played backwards, wrapping at its start
+  bool reverse {false};
+
+  // the pause marker, drawn over the top left corner of the screen
+  auto const marker = [](Output& o)
+  {
+    o.append(AEC::cursor_save).append(AEC::cursor_home)
+    .append(AEC::bold).append(AEC::reverse).append("||", 2).append(AEC::reset)
+    .append(AEC::cursor_load);
+  };
+
+  while (! exit && n < end)
+  {
+    if (count == 0 && src.size() > 0)
+    {
+      count = src.size();
+      if (loop_ != 0) end = loop_ * count;
+      continue;
+    }
+
+    size_t const i {count > 0 ? n % count : n};
+    size_t const loop_count {count > 0 ? loop_ - n / count : loop_};
+    size_t const frame_num {i + 1};
+
+    auto const tick = Clock::now();
+
+    View frame;
+    if (! src.view(i, frame))
+    {
+      // the end of the stream, or nothing to play
+      if (src.size() > 0) continue;
+      break;
+    }
+
+    if (! timeline.closed())
+    {
+      timeline.set(n, frame.delay);
+      if (count > 0 && timeline.size() >= count) timeline.close(count);
+    }
+    size_t const time {static_cast<size_t>((timeline.offset(n) - timeline.offset(n - i)) / 1000000)};
+    size_t const time_total {static_cast<size_t>(timeline.total() / 1000000)};
+
+    if (! diff_)
+    {
+      if (repaint)
+      {
+        repaint = false;
+        out.append(AEC::erase_screen).append(AEC::cursor_home);
+      }
+      else
+      {
+        clear_screen(out, line_num);
+      }
+      line_num = frame.height > 0 ? frame.height - 1 : 0;
 
-      line_num = 0;
-      ++frame_num;
-      std::stringstream out;
       if (debug_)
       {
         line_num += 2;
-        if (loop_ == 0)
-        {
-          out << "L | ";
-        }
-        else
-        {
-          out << loop_count << " | ";
-        }
-        out
-        << delay_ << " | "
-        << frame_num << "/" << frames.size() << "\n\n";
+        overlay(out, loop_count, frame_num, count, time, time_total, stats);
+        out.append("\n\n", 2);
+      }
+
+      Sgr::frame(out, frame);
+    }
+    else if (repaint)
+    {
+      repaint = false;
+      out.append(AEC::erase_screen).append(AEC::cursor_home);
+
+      if (debug_)
+      {
+        overlay(out, loop_count, frame_num, count, time, time_total, stats);
+        out.append("\n\n", 2);
+      }
+
+      Sgr::frame(out, frame);
+    }
+    else
+    {
+      if (debug_)
+      {
+        out.append(AEC::cursor_home).append(AEC::erase_line);
+        overlay(out, loop_count, frame_num, count, time, time_total, stats);
       }
 
-      auto line = delimit(e, "\n");
-      if (line.size() > 1)
+      size_t const origin {debug_ ? 3ul : 1ul};
+      if (ahead && ! reverse)
       {
-        for (size_t i = 0; i < line.size() - 2; ++i)
+        if (origin != ahead_origin)
         {
-          out << line.at(i) << "\n";
-          ++line_num;
+          ahead_origin = origin;
+          ahead->restart(n, origin);
         }
-        out << line.at(line.size() - 2);
+        buf = ahead->take(n);
       }
-      else if (line.size() == 1)
+
+      if (buf && buf->base == shown)
       {
-        out << line.at(0);
-        ++line_num;
+        out.attach(buf->out);
       }
-      std::cout << out.str() << std::flush;
+      else if (! diff.empty() && shown == (i > 0 ? i - 1 : count - 1))
+      {
+        Diff::encode(out, frame, diff.begin(i), diff.end(i), origin);
+      }
+      else
+      {
+        runs.clear();
+        Diff::compute(shown_view, frame, runs);
+        Diff::encode(out, frame, runs.data(), runs.data() + runs.size(), origin);
+      }
+    }
+    shown = i;
+    shown_view = frame;
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(delay_));
+    if (sched.paused())
+    {
+      marker(out);
+    }
 
-      // ----------------------------------------------------
+    auto const rendered = Clock::now();
+    if (term) term->set_deadline(sched.deadline(n + 1));
+    size_t bytes {out.flush()};
 
-      bool reset {false};
-      int num_read {0};
-      char c {0};
+    // the same frame, whole, for readers that can not be sent the changes
+    if (sink.behind())
+    {
+      key.append(AEC::erase_screen).append(AEC::cursor_home);
+      if (debug_)
+      {
+        overlay(key, loop_count, frame_num, count, time, time_total, stats);
+        key.append("\n\n", 2);
+      }
+      Sgr::frame(key, frame);
+      if (sched.paused()) marker(key);
+      bytes += key.flush();
+    }
+    auto const written = Clock::now();
+    Trace::record("render", tick, rendered, n);
+    Trace::record("write", rendered, written, n);
+
+    if (buf)
+    {
+      ahead->give(buf);
+      buf = nullptr;
+    }
+
+    Stats::Sample sample;
+    sample.render = elapsed(tick, rendered);
+    sample.write = elapsed(rendered, written);
+    sample.bytes = bytes;
+    sample.jitter = late;
+    stats.add(sample, sched.dropped(), slow);
+    late = 0;
+
+    if (headless_)
+    {
+      ++n;
+      continue;
+    }
+
+    {
+      Trace::Scope scope {"prefetch", n};
+      src.prefetch();
+    }
+
+    // wait for the next deadline, keys and signals are handled as they arrive,
+    // anything that changes what is on screen redraws the current frame at once
+    bool due {false};
+    bool reset {false};
+    bool redraw {false};
+    bool seek {false};
+    size_t to {n};
+
+    // the frames after n that came due while the terminal was behind
+    size_t held {0};
+    while (! exit && ! due && ! reset && ! redraw && ! seek)
+    {
+      events->arm(sched.deadline(n + held + 1));
+      auto const wait = Clock::now();
+      int const ev {next_event()};
+      Trace::record("wait", wait, Clock::now(), n);
 
-      while ((num_read = read(STDIN_FILENO, &c, 1)) == 1)
+      if (ev & Events::terminate)
       {
-        if (num_read == -1 && errno != EAGAIN)
+        exit = true;
+        break;
+      }
+
+      if (ev & Events::resize)
+      {
+        repaint = true;
+        redraw = true;
+      }
+
+      if (ev & Events::timer)
+      {
+        // a frame that a slow terminal would only show late is not sent,
+        // the one sent next carries its changes along, the last is always sent
+        if (term && skip_ == Scheduler::Skip::drop && ! reverse && ! repaint &&
+          n + held + 2 < end && term->late(sched.deadline(n + held + 2)))
         {
-          throw std::runtime_error("read failed");
+          ++held;
+          ++slow;
         }
+        else
+        {
+          due = true;
+          auto const now = Clock::now();
+          auto const deadline = sched.deadline(n + held + 1);
+          late = now > deadline ? elapsed(deadline, now) : 0;
+        }
+      }
 
+      auto const input = Clock::now();
+      char c {0};
+      while ((ev & Events::input) && events->key(c))
+      {
         if (static_cast<int>(c) == (static_cast<int>('c') & 0x1f))
         {
           throw std::runtime_error("program interrupt");
@@ -180,8 +924,12 @@ void Asciimation::main_loop(std::vector<std::string>& frames)
         }
         else if (static_cast<int>(c) == (static_cast<int>('d') & 0x1f))
         {
-          reset = true;
-          break;
+          // not possible while the length of a stream is unknown
+          if (count > 0)
+          {
+            reset = true;
+            break;
+          }
         }
         else if (c == 'q')
         {
@@ -191,12 +939,15 @@ void Asciimation::main_loop(std::vector<std::string>& frames)
         else if (c == 'd')
         {
           debug_ = ! debug_;
+          repaint = true;
+          redraw = true;
         }
         else if (c == 'j')
         {
           if (delay_ > 5)
           {
             delay_ -= 5;
+            sched.set_delay(delay_);
           }
         }
         else if (c == 'k')
@@ -204,6 +955,7 @@ void Asciimation::main_loop(std::vector<std::string>& frames)
           if (delay_ < 1000)
           {
             delay_ += 5;
+            sched.set_delay(delay_);
           }
         }
         else if (c == 'J')
@@ -211,6 +963,7 @@ void Asciimation::main_loop(std::vector<std::string>& frames)
           if (delay_ > 50)
           {
             delay_ -= 50;
+            sched.set_delay(delay_);
           }
         }
         else if (c == 'K')
@@ -218,85 +971,228 @@ void Asciimation::main_loop(std::vector<std::string>& frames)
           if (delay_ < 1000)
           {
             delay_ += 50;
+            sched.set_delay(delay_);
           }
         }
         else if (c == ' ')
         {
-          size_t x = 0;
-          size_t y = 0;
-          Term::cursor_get(x, y);
-          std::cout
-          << AEC::cursor_set(0, 0)
-          << AEC::wrap("||", {AEC::bold, AEC::reverse})
-          << AEC::cursor_set(x, y);
-          flush();
-          while ((num_read = read(STDIN_FILENO, &c, 1)) != 1)
+          // keys are still handled while paused
+          if (sched.paused())
           {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            sched.resume();
+            repaint = true;
+            redraw = true;
+            break;
           }
+          sched.pause();
+          marker(out);
+          out.flush();
         }
-        else if (c == 'h' || c == '?')
+        else if (c == 'r')
         {
-          clear_screen(line_num);
-          std::cout
-          << "Help:\n"
-          << "h -> show the help text\n"
-          << "q -> quit the asciimation\n"
-          << "d -> toggle debug output\n"
-          << "j -> decrease speed by 5\n"
-          << "J -> decrease speed by 50\n"
-          << "k -> increase speed by 5\n"
-          << "K -> increase speed by 50\n"
-          << "space -> pause the animation\n"
-          << "Press any key to continue";
-          flush();
-          line_num += 9;
-          while ((num_read = read(STDIN_FILENO, &c, 1)) != 1)
+          // not possible while the length of a stream is unknown
+          if (count > 0)
           {
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            reverse = ! reverse;
+            if (ahead && ! reverse) ahead->restart(n + 1, ahead_origin);
           }
         }
+        else if (c == ',' || c == '.' || (count > 0 && (c == 'g' || c == 'G' || (c >= '0' && c <= '9'))))
+        {
+          // seeking stays within the current loop, while the length of a stream
+          // is unknown it can only step, the tenths of a loop are found by time
+          // once its length is known
+          size_t const at {count > 0 ? to % count : to};
+          size_t target {at};
+          if (c == ',') target = at > 0 ? at - 1 : count > 0 ? count - 1 : at;
+          else if (c == '.') target = count == 0 || at + 1 < count ? at + 1 : 0;
+          else if (c == 'g') target = 0;
+          else if (c == 'G') target = count - 1;
+          else if (timeline.closed()) target = timeline.position(timeline.total() / 10 * (c - '0'));
+
+          // the next frame is always there, it would be played next anyway
+          if (target == at || (target != at + 1 && ! src.seekable(target))) continue;
+
+          // stepping pauses
+          if (c == ',' || c == '.') sched.pause();
+          to = to - at + target;
+          seek = true;
+        }
+        else if (c == 'h' || c == '?')
+        {
+          bool const paused {sched.paused()};
+          sched.pause();
+          clear_screen(out, line_num);
+          out.append(
+            "Help:\n"
+            "h -> show the help text\n"
+            "q -> quit the asciimation\n"
+            "d -> toggle debug output\n"
+            "j -> decrease speed by 5\n"
+            "J -> decrease speed by 50\n"
+            "k -> increase speed by 5\n"
+            "K -> increase speed by 50\n"
+            "space -> pause or resume the animation\n"
+            ", -> step back a frame\n"
+            ". -> step forward a frame\n"
+            "0-9 -> seek to a tenth of the loop\n"
+            "g -> seek to the first frame\n"
+            "G -> seek to the last frame\n"
+            "r -> toggle reverse playback\n"
+            "Press any key to continue"
+          ).flush();
+          line_num = 15;
+          exit = ! wait_key();
+          if (! paused) sched.resume();
+          repaint = true;
+          redraw = true;
+          break;
+        }
       }
 
-      clear_screen(line_num);
-      flush();
+      if (ev & Events::input)
+      {
+        Trace::record("input", input, Clock::now(), n);
+      }
+    }
 
-      if (reset) break;
+    if (reset)
+    {
+      // skip the rest of the current loop
+      n = (n / count + 1) * count;
+      sched.seek(n);
+    }
+    else if (seek)
+    {
+      // the frame on screen may not be viewable any more
+      n = to;
+      sched.seek(n);
+      if (ahead) ahead->restart(n + 1, ahead_origin);
+      if (! src.stable()) repaint = true;
+    }
+    else if (due && reverse && src.seekable(n % count > 0 ? n % count - 1 : count - 1))
+    {
+      n = n % count > 0 ? n - 1 : n + count - 1;
+      sched.seek(n);
+    }
+    else if (due)
+    {
+      n = sched.next(n + held);
     }
-    --loop_count;
   }
-}
 
-void Asciimation::flush() const
-{
-  std::cout << std::flush;
+  if (! stats_.empty())
+  {
+    std::ofstream ofile {stats_};
+    if (! ofile.is_open())
+    {
+      throw std::runtime_error("could not open stats file");
+    }
+    if (packing_) stats.set_packing(*packing_);
+    stats.write_json(ofile);
+  }
+
+  // the last frame is left in a headless output
+  if (headless_)
+  {
+    double const secs {std::chrono::duration<double>(Clock::now() - start).count()};
+    double const frames {static_cast<double>(stats.frames())};
+    std::cerr
+    << stats.frames() << " frames | "
+    << std::fixed << std::setprecision(3) << secs << "s | "
+    << std::setprecision(1) << (secs > 0 ? frames / secs : 0.0) << " fps | "
+    << (frames > 0 ? static_cast<double>(stats.bytes()) / frames : 0.0) << " B/frame";
+    if (packing_)
+    {
+      std::cerr << " | " << packing_->unpack.mean() / 1000.0 << " us/unpack";
+    }
+    std::cerr << "\n";
+    return;
+  }
+
+  if (diff_ && ! repaint)
+  {
+    out.append(AEC::cursor_home).append(AEC::erase_down);
+  }
+  else
+  {
+    clear_screen(out, line_num);
+  }
+  out.flush();
 }
 
-void Asciimation::clear_screen(size_t num) const
+void Asciimation::clear_screen(Output& out, size_t num)
 {
-  std::stringstream clr;
-  clr << AEC::erase_line << AEC::cr;
+  out.append(AEC::erase_line).append(AEC::cr);
   while (num > 0)
   {
-    clr << AEC::cursor_up << AEC::erase_line;
+    out.append(AEC::cursor_up).append(AEC::erase_line);
     --num;
   }
-  std::cout << clr.str();
 }
 
-size_t Asciimation::str_count(std::string const& str, std::string const& s) const
+void Asciimation::overlay(Output& out, size_t loop_count, size_t frame_num, size_t frame_total,
+  size_t time, size_t time_total, Stats const& stats) const
 {
-  size_t count {0};
-  size_t pos {0};
+  // milliseconds as seconds with a single decimal
+  auto const seconds = [&](size_t ms)
+  {
+    out.append(ms / 1000).append('.').append(ms / 100 % 10);
+  };
 
-  for (;;)
+  if (loop_ == 0)
+  {
+    out.append("L | ", 4);
+  }
+  else
+  {
+    out.append(loop_count).append(" | ", 3);
+  }
+  out.append(delay_).append(" | ", 3).append(frame_num).append('/');
+  if (frame_total == 0)
+  {
+    out.append('?');
+  }
+  else
+  {
+    out.append(frame_total);
+  }
+  out.append(" | ", 3);
+  seconds(time);
+  out.append('/');
+  if (time_total == 0)
+  {
+    out.append('?');
+  }
+  else
   {
-    pos = str.find(s, pos);
-    if (pos == std::string::npos) break;
-    ++count;
-    ++pos;
+    seconds(time_total);
   }
-  return count;
+  out.append('s');
+
+  // the last frame, then the rolling percentiles, times in microseconds
+  auto const times = [&](Stats::Sample const& e)
+  {
+    out.append(static_cast<size_t>(e.render / 1000));
+    out.append('/').append(static_cast<size_t>(e.write / 1000));
+    out.append('/').append(static_cast<size_t>(e.jitter / 1000));
+  };
+
+  auto const& last = stats.last();
+  out.append(" | ", 3).append(static_cast<size_t>(last.bytes)).append('B');
+  out.append(" | r", 4).append(static_cast<size_t>(last.render / 1000));
+  out.append(" w", 2).append(static_cast<size_t>(last.write / 1000));
+  out.append(" j", 2).append(static_cast<size_t>(last.jitter / 1000));
+  out.append("us", 2);
+
+  out.append(" | p50 ", 7);
+  times(stats.percentile(50));
+
+  out.append(" | p99 ", 7);
+  times(stats.percentile(99));
+
+  out.append(" | d", 4).append(stats.dropped());
+  out.append(" s", 2).append(stats.slow());
 }
 
 void Asciimation::check_window_size(std::map<std::string, std::string>& headers) const
@@ -322,19 +1218,4 @@ void Asciimation::check_window_size(std::map<std::string, std::string>& headers)
   }
 }
 
-std::vector<std::string> Asciimation::delimit(std::string const& str, std::string const delim) const
-{
-  std::vector<std::string> vtok;
-  size_t start {0};
-  size_t end = str.find(delim);
-  while (end != std::string::npos)
-  {
-    vtok.emplace_back(str.substr(start, end - start));
-    start = end + delim.length();
-    end = str.find(delim, start);
-  }
-  vtok.emplace_back(str.substr(start, end));
-  return vtok;
-}
-
 } // namespace OB
@@ -1,6 +1,17 @@
 #ifndef OB_ASCIIMATION_HH
 #define OB_ASCIIMATION_HH
 
+#include "plan.hh"
+#include "diff.hh"
+#include "scheduler.hh"
+#include "output.hh"
+#include "source.hh"
+#include "stream.hh"
+#include "stats.hh"
+#include "mmap.hh"
+
+#include <unistd.h>
+
 #include <string>
 #include <vector>
 #include <map>
@@ -17,22 +28,82 @@ public:
   Asciimation& set_debug(bool debug);
   Asciimation& set_loop(size_t loop);
   Asciimation& set_delay(size_t delay);
+
+  // start at a frame, 1 based, or at a point in seconds of the first loop
+  Asciimation& set_start_frame(size_t frame);
+  Asciimation& set_start_time(double time);
+
+  Asciimation& set_render(std::string render);
+  Asciimation& set_skip(std::string skip);
+  Asciimation& set_buffer(size_t buffer);
+
+  // frames taking more than memory MiB are kept packed, 0 for no limit
+  Asciimation& set_memory(size_t memory);
+  Asciimation& set_ahead(size_t ahead);
+  Asciimation& set_stream_loop(std::string keep);
   Asciimation& set_delim(std::string delim);
+  Asciimation& set_cache(bool cache);
+
+  // play without a terminal into a file, 'null' or 'vt', an in-memory terminal,
+  // an empty output with no tty writes to stdout
+  Asciimation& set_output(std::string output);
+  Asciimation& set_tty(bool tty);
+
+  // also play to these terminals, a comma separated list of paths,
+  // and to every client that connects to a unix socket at this path
+  Asciimation& set_ttys(std::string ttys);
+  Asciimation& set_socket(std::string socket);
+
+  // write the frame timing histograms as json on exit,
+  // along with what interning the frames saved
+  Asciimation& set_stats(std::string stats);
+
+  // write when each stage ran as a chrome trace on exit
+  Asciimation& set_trace(std::string trace);
   void run(std::string file_name);
+  void compile(std::string file_name, std::string out_name);
+
+  // erase the num lines above the cursor and the current line
+  static void clear_screen(Output& out, size_t num);
 
 private:
   bool debug_ {false};
   size_t loop_ {false};
   size_t delay_ {250};
+  size_t start_frame_ {0};
+  double start_time_ {0};
+  bool diff_ {false};
+  Scheduler::Skip skip_ {Scheduler::Skip::drop};
+  size_t buffer_ {16};
+  size_t memory_ {0};
+  size_t ahead_ {4};
+  Stream::Keep keep_ {Stream::Keep::spill};
+  int input_ {STDIN_FILENO};
   std::string delim_ {"END\n"};
   std::string begin_ {"BEGIN"};
+  bool cache_ {false};
+  bool headless_ {false};
+  bool tty_ {true};
+  std::vector<std::string> ttys_;
+  std::string socket_;
+  std::string output_;
+  std::string stats_;
+  Dedup dedup_;
+
+  // the frames being played, while they are packed
+  Packing const* packing_ {nullptr};
+  std::string trace_;
 
-  void main_loop(std::vector<std::string>& frames);
-  void flush() const;
-  void clear_screen(size_t num) const;
-  size_t str_count(std::string const& str, std::string const& s) const;
+  void play_file(std::string const& file_name);
+  void stream(std::string const& file_name, std::map<std::string, std::string>& headers);
+  Plan load(Mmap&& map, std::map<std::string, std::string>& headers) const;
+  void open_plan(std::string const& file_name, Plan& plan, Diff& diff, std::map<std::string, std::string>& headers) const;
+  void parse_header(std::string const& line, size_t line_num, std::map<std::string, std::string>& headers) const;
+  void play(Source& src, Diff const& diff, std::map<std::string, std::string>& headers);
+  void main_loop(Source& src, Diff const& diff, Sink& sink);
+  void overlay(Output& out, size_t loop_count, size_t frame_num, size_t frame_total,
+    size_t time, size_t time_total, Stats const& stats) const;
   void check_window_size(std::map<std::string, std::string>& headers) const;
-  std::vector<std::string> delimit(std::string const& str, std::string const delim) const;
 
 }; // class Asciimation
 
@@ -0,0 +1,243 @@
+#include "broadcast.hh"
+#include "output.hh"
+
+#include "ansi_escape_codes.hh"
+namespace AEC = OB::ANSI_Escape_Codes;
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <cstddef>
+#include <cstring>
+#include <cerrno>
+
+namespace OB
+{
+
+namespace
+{
+
+  // connections waiting to be accepted
+  int const backlog {16};
+
+  // write what the reader takes without waiting, 0 if it takes nothing now,
+  // -1 once it is gone, a socket whose client has left does not raise SIGPIPE
+  ssize_t put(int fd, bool socket, struct iovec const* iov, size_t cnt)
+  {
+    for (;;)
+    {
+      ssize_t num {-1};
+      if (socket)
+      {
+        struct msghdr msg {};
+        msg.msg_iov = const_cast<struct iovec*>(iov);
+        msg.msg_iovlen = cnt;
+        num = sendmsg(fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+      }
+      else
+      {
+        num = writev(fd, iov, static_cast<int>(cnt));
+      }
+
+      if (num >= 0) return num;
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN) return 0;
+      return -1;
+    }
+  }
+
+} // namespace
+
+Broadcast::Broadcast(std::vector<std::string> const& ttys, std::string const& path, Sink* local) :
+  local_ {local}
+{
+  for (auto const& e : ttys)
+  {
+    int const fd {open(e.c_str(), O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)};
+    if (fd == -1)
+    {
+      throw std::runtime_error("could not open tty '" + e + "'");
+    }
+    add(fd, false);
+  }
+
+  if (path.empty()) return;
+
+  struct sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+  {
+    throw std::runtime_error("socket path is too long");
+  }
+  std::memcpy(addr.sun_path, path.data(), path.size());
+
+  // a socket left behind by a run that did not exit cleanly is replaced
+  struct stat st;
+  if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+  {
+    unlink(path.c_str());
+  }
+
+  listen_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_ == -1 ||
+    bind(listen_, reinterpret_cast<struct sockaddr const*>(&addr), sizeof(addr)) == -1 ||
+    listen(listen_, backlog) == -1)
+  {
+    throw std::runtime_error("could not listen on socket '" + path + "'");
+  }
+  path_ = path;
+}
+
+Broadcast::~Broadcast()
+{
+  // whatever is still pending is given up on
+  for (auto& e : readers_)
+  {
+    if (e.fd == -1) continue;
+    struct iovec iov {const_cast<char*>(AEC::cursor_show.data), AEC::cursor_show.size};
+    put(e.fd, e.socket, &iov, 1);
+    close(e.fd);
+  }
+
+  if (listen_ != -1)
+  {
+    close(listen_);
+    unlink(path_.c_str());
+  }
+}
+
+void Broadcast::write(struct iovec* iov, size_t cnt)
+{
+  State const to {key_ ? State::keying : State::synced};
+  for (auto& e : readers_)
+  {
+    if (e.fd != -1 && e.state == to) send(e, iov, cnt);
+  }
+
+  // last, as it may modify the iovecs
+  if (local_ && ! key_)
+  {
+    local_->write(iov, cnt);
+  }
+}
+
+void Broadcast::end()
+{
+  // a reader that could not take the whole frame falls behind,
+  // it is not sent anything more until it has taken the rest
+  State const from {key_ ? State::keying : State::synced};
+  for (auto& e : readers_)
+  {
+    if (e.fd == -1 || e.state != from) continue;
+    if (! drain(e)) continue;
+    e.state = e.pending.empty() ? State::synced : State::stale;
+  }
+  key_ = false;
+}
+
+bool Broadcast::behind()
+{
+  accept();
+
+  key_ = false;
+  for (auto& e : readers_)
+  {
+    if (e.fd != -1 && e.state == State::stale && drain(e) && e.pending.empty())
+    {
+      e.state = State::keying;
+      key_ = true;
+    }
+  }
+
+  readers_.erase(std::remove_if(readers_.begin(), readers_.end(),
+    [](Reader const& e) { return e.fd == -1; }), readers_.end());
+
+  return key_;
+}
+
+void Broadcast::add(int fd, bool socket)
+{
+  Reader r;
+  r.fd = fd;
+  r.socket = socket;
+  r.pending.assign(AEC::cursor_hide.data, AEC::cursor_hide.size);
+  readers_.emplace_back(std::move(r));
+}
+
+void Broadcast::accept()
+{
+  if (listen_ == -1) return;
+
+  for (;;)
+  {
+    int const fd {accept4(listen_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)};
+    if (fd == -1)
+    {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      return;
+    }
+    add(fd, true);
+  }
+}
+
+void Broadcast::send(Reader& r, struct iovec const* iov, size_t cnt)
+{
+  // the rest of the frame queues behind what is already pending
+  if (! drain(r)) return;
+
+  size_t skip {0};
+  if (r.pending.empty())
+  {
+    ssize_t const num {put(r.fd, r.socket, iov, cnt)};
+    if (num == -1)
+    {
+      drop(r);
+      return;
+    }
+    skip = static_cast<size_t>(num);
+  }
+
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    if (skip >= iov[i].iov_len)
+    {
+      skip -= iov[i].iov_len;
+      continue;
+    }
+    r.pending.append(static_cast<char const*>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+    skip = 0;
+  }
+}
+
+bool Broadcast::drain(Reader& r)
+{
+  if (r.pending.empty()) return true;
+
+  struct iovec iov {&r.pending[0], r.pending.size()};
+  ssize_t const num {put(r.fd, r.socket, &iov, 1)};
+  if (num == -1)
+  {
+    drop(r);
+    return false;
+  }
+  r.pending.erase(0, static_cast<size_t>(num));
+  return true;
+}
+
+void Broadcast::drop(Reader& r)
+{
+  close(r.fd);
+  r.fd = -1;
+  r.pending.clear();
+}
+
+} // namespace OB
@@ -0,0 +1,73 @@
+#ifndef OB_BROADCAST_HH
+#define OB_BROADCAST_HH
+
+#include "output.hh"
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace OB
+{
+
+// the same output written to many readers at once, terminals opened by name
+// and clients of a unix socket, none of them is waited on,
+// a reader that can not take a whole frame is skipped until it has caught up
+// and is then sent a whole frame to start over from
+class Broadcast : public Sink
+{
+public:
+  // the socket is created at path, replacing a stale one, and removed again on exit,
+  // the local sink, if any, is written as a blocking sink always is
+  Broadcast(std::vector<std::string> const& ttys, std::string const& path, Sink* local = nullptr);
+  Broadcast(Broadcast const&) = delete;
+  Broadcast& operator=(Broadcast const&) = delete;
+  ~Broadcast();
+
+  void write(struct iovec* iov, size_t cnt) override;
+  void end() override;
+
+  // takes in new clients, true if any reader waits for a whole frame,
+  // the next frame written then only goes to those readers
+  bool behind() override;
+
+private:
+  enum class State
+  {
+    // sent every frame
+    synced,
+    // fell behind or just joined, skipped until it has taken what is pending
+    stale,
+    // sent the next frame, which is a whole one
+    keying
+  };
+
+  struct Reader
+  {
+    int fd {-1};
+    bool socket {false};
+    State state {State::stale};
+
+    // the rest of a frame that was only partly written
+    std::string pending;
+  }; // struct Reader
+
+  std::vector<Reader> readers_;
+  Sink* local_ {nullptr};
+  int listen_ {-1};
+  std::string path_;
+  bool key_ {false};
+
+  void add(int fd, bool socket);
+  void accept();
+  void send(Reader& r, struct iovec const* iov, size_t cnt);
+  bool drain(Reader& r);
+  void drop(Reader& r);
+
+}; // class Broadcast
+
+} // namespace OB
+
+#endif // OB_BROADCAST_HH
@@ -0,0 +1,276 @@
+#include "color.hh"
+#include "source.hh"
+#include "output.hh"
+
+#include "ansi_escape_codes.hh"
+namespace AEC = OB::ANSI_Escape_Codes;
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace OB
+{
+
+namespace
+{
+
+char const keyword[] {"COLOR"};
+size_t const keyword_size {sizeof(keyword) - 1};
+
+char const* const names[] {"black", "red", "green", "yellow", "blue", "magenta", "cyan", "white"};
+
+int hex(char c)
+{
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+bool number(std::string const& str, size_t& num)
+{
+  if (str.empty() || str.size() > 9) return false;
+  num = 0;
+  for (auto const c : str)
+  {
+    if (c < '0' || c > '9') return false;
+    num = num * 10 + static_cast<size_t>(c - '0');
+  }
+  return true;
+}
+
+// the parameters that select a color, base is 30 for the foreground and 40 for the background
+char* params(char* buf, uint32_t color, size_t base)
+{
+  uint32_t const kind {color & 0xff000000u};
+  uint32_t const value {color & 0x00ffffffu};
+  if (kind == Sgr::basic)
+  {
+    return AEC::decimal(buf, base + value);
+  }
+  if (kind == Sgr::bright)
+  {
+    return AEC::decimal(buf, base + 60 + value);
+  }
+  if (kind == Sgr::index)
+  {
+    buf = AEC::decimal(buf, base + 8);
+    std::memcpy(buf, ";5;", 3);
+    return AEC::decimal(buf + 3, value);
+  }
+  if (kind == Sgr::rgb)
+  {
+    buf = AEC::decimal(buf, base + 8);
+    std::memcpy(buf, ";2;", 3);
+    buf = AEC::decimal(buf + 3, value >> 16);
+    *buf++ = ';';
+    buf = AEC::decimal(buf, (value >> 8) & 0xff);
+    *buf++ = ';';
+    return AEC::decimal(buf, value & 0xff);
+  }
+  return AEC::decimal(buf, base + 9);
+}
+
+} // namespace
+
+uint32_t const Sgr::basic;
+uint32_t const Sgr::bright;
+uint32_t const Sgr::index;
+uint32_t const Sgr::rgb;
+
+bool Sgr::is_color(char const* data, size_t len)
+{
+  return len >= keyword_size && std::memcmp(data, keyword, keyword_size) == 0 &&
+    (len == keyword_size || data[keyword_size] == ' ');
+}
+
+Region Sgr::parse(char const* data, size_t len, size_t frame, size_t line)
+{
+  std::vector<std::string> tokens;
+  size_t pos {keyword_size};
+  while (pos < len)
+  {
+    while (pos < len && data[pos] == ' ') ++pos;
+    if (pos == len) break;
+    size_t end {pos};
+    while (end < len && data[end] != ' ') ++end;
+    tokens.emplace_back(data + pos, end - pos);
+    pos = end;
+  }
+
+  Region region;
+  region.height = ~static_cast<size_t>(0);
+  region.width = ~static_cast<size_t>(0);
+
+  bool ok {! tokens.empty() && color(tokens[0], region.style.fg)};
+  size_t i {1};
+  if (ok && i < tokens.size() && tokens[i] != "at")
+  {
+    ok = color(tokens[i], region.style.bg);
+    ++i;
+  }
+
+  if (ok && i < tokens.size())
+  {
+    size_t const n {tokens.size() - i - 1};
+    ok = tokens[i] == "at" && (n == 2 || n == 4) &&
+      number(tokens[i + 1], region.row) && region.row > 0 &&
+      number(tokens[i + 2], region.col) && region.col > 0 &&
+      (n == 2 || (number(tokens[i + 3], region.height) && number(tokens[i + 4], region.width)));
+    --region.row;
+    --region.col;
+  }
+
+  if (! ok)
+  {
+    throw std::runtime_error("invalid color at frame " + std::to_string(frame + 1) + ", line " + std::to_string(line + 1));
+  }
+
+  return region;
+}
+
+bool Sgr::color(std::string const& str, uint32_t& color)
+{
+  if (str == "default")
+  {
+    color = 0;
+    return true;
+  }
+
+  for (uint32_t i = 0; i < 8; ++i)
+  {
+    if (str == names[i])
+    {
+      color = basic | i;
+      return true;
+    }
+    if (str.size() == 7 + std::strlen(names[i]) && str.compare(0, 7, "bright-") == 0 && str.compare(7, std::string::npos, names[i]) == 0)
+    {
+      color = bright | i;
+      return true;
+    }
+  }
+
+  if (str.size() == 7 && str[0] == '#')
+  {
+    uint32_t value {0};
+    for (size_t i = 1; i < 7; ++i)
+    {
+      int const h {hex(str[i])};
+      if (h < 0) return false;
+      value = (value << 4) | static_cast<uint32_t>(h);
+    }
+    color = rgb | value;
+    return true;
+  }
+
+  size_t num {0};
+  if (number(str, num) && num < 256)
+  {
+    color = index | static_cast<uint32_t>(num);
+    return true;
+  }
+
+  return false;
+}
+
+void Sgr::paint(View const& v, size_t row, size_t len, std::vector<Style>& styles)
+{
+  styles.assign(len, Style());
+  for (size_t i = 0; i < v.region_count; ++i)
+  {
+    auto const& e = v.regions[i];
+    if (row < e.row || row - e.row >= e.height || e.col >= len) continue;
+    size_t const end {e.col + std::min(e.width, len - e.col)};
+    std::fill(styles.begin() + static_cast<std::ptrdiff_t>(e.col), styles.begin() + static_cast<std::ptrdiff_t>(end), e.style);
+  }
+}
+
+void Sgr::frame(Output& out, View const& v)
+{
+  if (v.region_count == 0 && v.rows == nullptr)
+  {
+    out.attach(v.data, v.size);
+    return;
+  }
+
+  // interned rows are written with the newline stored after them,
+  // rows that follow each other in memory go out as one segment
+  if (v.region_count == 0)
+  {
+    for (size_t r = 0; r < v.height; ++r)
+    {
+      auto const& row = v.rows[v.lines[r]];
+      out.attach(v.data + row.off, row.len + (r + 1 < v.height ? 1 : 0));
+    }
+    return;
+  }
+
+  Sgr sgr;
+  std::vector<Style> styles;
+  for (size_t r = 0; r < v.height; ++r)
+  {
+    size_t len {0};
+    char const* const line {v.line(r, len)};
+    paint(v, r, len, styles);
+    sgr.cells(out, line, styles.data(), len);
+    if (r + 1 < v.height) out.append('\n');
+  }
+  sgr.to(out, Style());
+}
+
+void Sgr::cells(Output& out, char const* data, Style const* styles, size_t len)
+{
+  size_t begin {0};
+  while (begin < len)
+  {
+    size_t end {begin + 1};
+    while (end < len && styles[end] == styles[begin]) ++end;
+    to(out, styles[begin]);
+    out.append(data + begin, end - begin);
+    begin = end;
+  }
+}
+
+void Sgr::to(Output& out, Style const& style)
+{
+  if (style == state_) return;
+
+  // back to the default is the shortest sequence there is
+  if (style == Style())
+  {
+    out.append("\033[m", 3);
+    state_ = style;
+    return;
+  }
+
+  // both colors changing in 24 bit is the longest sequence
+  char buf[2 * AEC::true_max];
+  char* end {buf};
+  *end++ = '\033';
+  *end++ = '[';
+  if (style.fg != state_.fg)
+  {
+    end = params(end, style.fg, 30);
+  }
+  if (style.bg != state_.bg)
+  {
+    if (end != buf + 2) *end++ = ';';
+    end = params(end, style.bg, 40);
+  }
+  *end++ = 'm';
+  out.append(buf, static_cast<size_t>(end - buf));
+  state_ = style;
+}
+
+Style const& Sgr::state() const
+{
+  return state_;
+}
+
+} // namespace OB
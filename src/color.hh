@@ -0,0 +1,91 @@
+#ifndef OB_COLOR_HH
+#define OB_COLOR_HH
+
+#include "source.hh"
+#include "output.hh"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// foreground and background of a cell,
+// a color is 0 for the terminal default, or a kind in the top byte and its value below
+struct Style
+{
+  uint32_t fg {0};
+  uint32_t bg {0};
+
+  bool operator==(Style const& other) const
+  {
+    return fg == other.fg && bg == other.bg;
+  }
+
+  bool operator!=(Style const& other) const
+  {
+    return ! (*this == other);
+  }
+}; // struct Style
+
+// a rectangle of a frame drawn in a style, later regions are drawn over earlier ones
+struct Region
+{
+  size_t row {0};
+  size_t col {0};
+  size_t height {0};
+  size_t width {0};
+  Style style;
+}; // struct Region
+
+// color directives and the select graphic rendition state of the terminal
+//
+// a frame line of the form 'COLOR fg [bg] [at row col [height width]]'
+// colors the whole frame or a region of it, rows and columns are 1-based
+// and the region runs to the end of the frame unless its size is given,
+// a color is a name such as 'red' or 'bright-red', 'default',
+// a palette index from 0 to 255 or '#rrggbb'
+//
+// every frame starts and ends in the default style, in between only the
+// attributes that change are written, merged into a single sequence
+class Sgr
+{
+public:
+  static uint32_t const basic {1u << 24};
+  static uint32_t const bright {2u << 24};
+  static uint32_t const index {3u << 24};
+  static uint32_t const rgb {4u << 24};
+
+  // whether the line is a color directive
+  static bool is_color(char const* data, size_t len);
+
+  // parse a color directive, throws on invalid syntax
+  static Region parse(char const* data, size_t len, size_t frame, size_t line);
+
+  // parse a single color, false if it is not one
+  static bool color(std::string const& str, uint32_t& color);
+
+  // the style of each of the len cells of a row
+  static void paint(View const& v, size_t row, size_t len, std::vector<Style>& styles);
+
+  // write a whole frame
+  static void frame(Output& out, View const& v);
+
+  // write len cells, each in its own style
+  void cells(Output& out, char const* data, Style const* styles, size_t len);
+
+  // move to style, writes nothing if the terminal is already in it
+  void to(Output& out, Style const& style);
+
+  Style const& state() const;
+
+private:
+  Style state_;
+
+}; // class Sgr
+
+} // namespace OB
+
+#endif // OB_COLOR_HH
@@ -0,0 +1,378 @@
+#include "compiled.hh"
+#include "mmap.hh"
+#include "plan.hh"
+#include "diff.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <utility>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+
+namespace OB
+{
+
+namespace
+{
+
+char const magic[4] {'A', 'S', 'C', 'M'};
+uint32_t const version {4};
+uint32_t const order {0x01020304};
+
+// flags
+uint64_t const has_runs {1};
+
+struct Head
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t word;
+  uint32_t order;
+  uint64_t flags;
+
+  uint64_t key;
+  uint64_t mtime;
+  uint64_t source_size;
+  uint64_t inode;
+  uint64_t ctime;
+  uint64_t sample;
+
+  uint64_t headers_off;
+  uint64_t headers_size;
+  uint64_t data_off;
+  uint64_t data_size;
+  uint64_t frames_off;
+  uint64_t frame_count;
+  uint64_t lines_off;
+  uint64_t line_count;
+  uint64_t index_off;
+  uint64_t runs_off;
+  uint64_t run_count;
+  uint64_t regions_off;
+  uint64_t region_count;
+}; // struct Head
+
+uint64_t fnv1a(uint64_t hash, char const* data, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// bytes hashed at each end of the source for its origin
+size_t const sample_size {4096};
+
+// hash of the first and the last bytes of a file
+uint64_t sample(int fd, uint64_t size)
+{
+  char buf[sample_size];
+  uint64_t hash {0xcbf29ce484222325ull};
+  for (uint64_t const off : {static_cast<uint64_t>(0), size > sample_size ? size - sample_size : 0})
+  {
+    ssize_t const num {pread(fd, buf, sample_size, static_cast<off_t>(off))};
+    if (num > 0) hash = fnv1a(hash, buf, static_cast<size_t>(num));
+  }
+  return hash;
+}
+
+uint64_t align(uint64_t off)
+{
+  return (off + 7) & ~static_cast<uint64_t>(7);
+}
+
+void invalid()
+{
+  throw std::runtime_error("invalid compiled file");
+}
+
+// whether [off, off + count * size) lies inside the mapping
+bool within(Mmap const& map, uint64_t off, uint64_t count, uint64_t size)
+{
+  if (off % 8 != 0 || off > map.size()) return false;
+  if (size != 0 && count > (map.size() - off) / size) return false;
+  return true;
+}
+
+bool head(Mmap const& map, Head& h)
+{
+  if (map.size() < sizeof(Head)) return false;
+  std::memcpy(&h, map.data(), sizeof(Head));
+  return std::memcmp(h.magic, magic, sizeof(magic)) == 0 &&
+    h.version == version &&
+    h.word == sizeof(size_t) &&
+    h.order == order;
+}
+
+} // namespace
+
+Compiled::Origin Compiled::origin(std::string const& file_name, std::string const& delim)
+{
+  Origin o;
+
+  char path[PATH_MAX];
+  std::string const key {realpath(file_name.c_str(), path) ? path : file_name};
+  o.key = fnv1a(0xcbf29ce484222325ull, key.data(), key.size() + 1);
+  o.key = fnv1a(o.key, delim.data(), delim.size());
+
+  int const fd {open(file_name.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd == -1) return o;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0)
+  {
+    o.mtime = static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_mtim.tv_nsec);
+    o.ctime = static_cast<uint64_t>(st.st_ctim.tv_sec) * 1000000000ull + static_cast<uint64_t>(st.st_ctim.tv_nsec);
+    o.size = static_cast<uint64_t>(st.st_size);
+    o.inode = static_cast<uint64_t>(st.st_ino);
+    o.sample = sample(fd, o.size);
+  }
+  close(fd);
+
+  return o;
+}
+
+std::string Compiled::cache_path(Origin const& origin)
+{
+  std::string dir;
+  if (char const* xdg = std::getenv("XDG_CACHE_HOME"))
+  {
+    dir = xdg;
+  }
+  else if (char const* home = std::getenv("HOME"))
+  {
+    dir = std::string(home) + "/.cache";
+  }
+  if (dir.empty()) return {};
+
+  mkdir(dir.c_str(), 0700);
+  dir += "/asciimation";
+  if (mkdir(dir.c_str(), 0700) == -1 && errno != EEXIST) return {};
+
+  char name[17];
+  static char const hex[] {"0123456789abcdef"};
+  for (size_t i = 0; i < 16; ++i)
+  {
+    name[i] = hex[(origin.key >> ((15 - i) * 4)) & 0xf];
+  }
+  name[16] = '\0';
+
+  return dir + "/" + name + ".asc";
+}
+
+bool Compiled::is_compiled(Mmap const& map)
+{
+  return map.size() >= sizeof(magic) && std::memcmp(map.data(), magic, sizeof(magic)) == 0;
+}
+
+bool Compiled::read_origin(Mmap const& map, Origin& origin)
+{
+  Head h;
+  if (! head(map, h)) return false;
+  origin.key = h.key;
+  origin.mtime = h.mtime;
+  origin.size = h.source_size;
+  origin.inode = h.inode;
+  origin.ctime = h.ctime;
+  origin.sample = h.sample;
+  return true;
+}
+
+void Compiled::write(std::string const& file_name, Plan const& plan, Diff const& diff,
+  std::map<std::string, std::string> const& headers, Origin const& origin)
+{
+  // the frames of an interned plan share rows out of order,
+  // they are not one run of bytes that can be copied out
+  if (plan.rows() != nullptr)
+  {
+    throw std::runtime_error("an interned plan can not be compiled");
+  }
+
+  // frame offsets are rebased onto the start of the first frame
+  size_t const count {plan.size()};
+  size_t data_begin {0};
+  size_t data_end {0};
+  if (count > 0)
+  {
+    data_begin = plan.frames()[0].off;
+    data_end = plan.frames()[count - 1].off + plan.frames()[count - 1].size;
+  }
+
+  std::string blob;
+  for (auto const& e : headers)
+  {
+    uint32_t const klen {static_cast<uint32_t>(e.first.size())};
+    uint32_t const vlen {static_cast<uint32_t>(e.second.size())};
+    blob.append(reinterpret_cast<char const*>(&klen), sizeof(klen));
+    blob.append(reinterpret_cast<char const*>(&vlen), sizeof(vlen));
+    blob.append(e.first);
+    blob.append(e.second);
+  }
+
+  bool const runs {! diff.empty() && diff.size() == count};
+
+  Head h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = version;
+  h.word = sizeof(size_t);
+  h.order = order;
+  h.flags = runs ? has_runs : 0;
+  h.key = origin.key;
+  h.mtime = origin.mtime;
+  h.source_size = origin.size;
+  h.inode = origin.inode;
+  h.ctime = origin.ctime;
+  h.sample = origin.sample;
+
+  h.headers_off = align(sizeof(Head));
+  h.headers_size = blob.size();
+  h.frames_off = align(h.headers_off + h.headers_size);
+  h.frame_count = count;
+  h.lines_off = align(h.frames_off + count * sizeof(Frame));
+  h.line_count = plan.line_count();
+  h.index_off = align(h.lines_off + h.line_count * sizeof(size_t));
+  h.run_count = runs ? diff.index()[count] : 0;
+  h.runs_off = align(h.index_off + (runs ? (count + 1) * sizeof(size_t) : 0));
+  h.region_count = plan.region_count();
+  h.regions_off = align(h.runs_off + h.run_count * sizeof(Run));
+  h.data_off = align(h.regions_off + h.region_count * sizeof(Region));
+  h.data_size = data_end - data_begin;
+
+  // written next to the target and renamed into place,
+  // so a reader never sees a partial file
+  std::string const tmp {file_name + ".tmp." + std::to_string(getpid())};
+  std::ofstream ofile {tmp, std::ios::binary | std::ios::trunc};
+  if (! ofile.is_open())
+  {
+    throw std::runtime_error("could not open output file");
+  }
+
+  uint64_t pos {0};
+  auto const put = [&](void const* data, uint64_t size, uint64_t at)
+  {
+    static char const zero[8] {};
+    while (pos < at)
+    {
+      ofile.write(zero, static_cast<std::streamsize>(at - pos < 8 ? at - pos : 8));
+      pos += at - pos < 8 ? at - pos : 8;
+    }
+    ofile.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+    pos += size;
+  };
+
+  put(&h, sizeof(h), 0);
+  put(blob.data(), blob.size(), h.headers_off);
+
+  std::vector<Frame> frames (plan.frames(), plan.frames() + count);
+  for (auto& e : frames)
+  {
+    e.off -= data_begin;
+  }
+  put(frames.data(), count * sizeof(Frame), h.frames_off);
+  put(plan.lines(), h.line_count * sizeof(size_t), h.lines_off);
+
+  if (runs)
+  {
+    put(diff.index(), (count + 1) * sizeof(size_t), h.index_off);
+    put(diff.runs(), h.run_count * sizeof(Run), h.runs_off);
+  }
+
+  put(plan.regions(), h.region_count * sizeof(Region), h.regions_off);
+  put(plan.base() + data_begin, h.data_size, h.data_off);
+
+  ofile.close();
+  if (! ofile || rename(tmp.c_str(), file_name.c_str()) == -1)
+  {
+    unlink(tmp.c_str());
+    throw std::runtime_error("could not write output file");
+  }
+}
+
+void Compiled::read(Mmap&& map, Plan& plan, Diff& diff, std::map<std::string, std::string>& headers)
+{
+  Head h;
+  if (! head(map, h)) invalid();
+
+  if (! within(map, h.headers_off, h.headers_size, 1) ||
+    ! within(map, h.data_off, h.data_size, 1) ||
+    ! within(map, h.frames_off, h.frame_count, sizeof(Frame)) ||
+    ! within(map, h.lines_off, h.line_count, sizeof(size_t)) ||
+    ! within(map, h.regions_off, h.region_count, sizeof(Region)))
+  {
+    invalid();
+  }
+
+  // header table
+  char const* pos {map.data() + h.headers_off};
+  char const* const last {pos + h.headers_size};
+  while (pos != last)
+  {
+    uint32_t klen;
+    uint32_t vlen;
+    if (static_cast<size_t>(last - pos) < sizeof(klen) + sizeof(vlen)) invalid();
+    std::memcpy(&klen, pos, sizeof(klen));
+    std::memcpy(&vlen, pos + sizeof(klen), sizeof(vlen));
+    pos += sizeof(klen) + sizeof(vlen);
+    if (static_cast<size_t>(last - pos) < static_cast<size_t>(klen) + vlen) invalid();
+    headers[std::string(pos, klen)] = std::string(pos + klen, vlen);
+    pos += klen + vlen;
+  }
+
+  // every frame and line must stay inside the data section
+  auto const frames = reinterpret_cast<Frame const*>(map.data() + h.frames_off);
+  auto const lines = reinterpret_cast<size_t const*>(map.data() + h.lines_off);
+  for (size_t i = 0; i < h.frame_count; ++i)
+  {
+    auto const& f = frames[i];
+    if (f.off > h.data_size || f.size > h.data_size - f.off) invalid();
+    if (f.line > h.line_count || f.height > h.line_count - f.line) invalid();
+    if (f.region > h.region_count || f.region_count > h.region_count - f.region) invalid();
+    for (size_t j = 0; j < f.height; ++j)
+    {
+      if (lines[f.line + j] > f.size) invalid();
+    }
+  }
+
+  Run const* runs {nullptr};
+  size_t const* index {nullptr};
+  if (h.flags & has_runs)
+  {
+    if (! within(map, h.index_off, h.frame_count + 1, sizeof(size_t)) ||
+      ! within(map, h.runs_off, h.run_count, sizeof(Run)))
+    {
+      invalid();
+    }
+
+    runs = reinterpret_cast<Run const*>(map.data() + h.runs_off);
+    index = reinterpret_cast<size_t const*>(map.data() + h.index_off);
+    for (size_t i = 0; i < h.frame_count; ++i)
+    {
+      if (index[i] > index[i + 1] || index[i + 1] > h.run_count) invalid();
+      for (size_t j = index[i]; j < index[i + 1]; ++j)
+      {
+        if (runs[j].off > frames[i].size || runs[j].len > frames[i].size - runs[j].off) invalid();
+      }
+    }
+  }
+
+  // the mapping keeps its address when it is moved into the plan
+  plan = Plan(std::move(map), h.data_off, h.frames_off, h.frame_count, h.lines_off, h.line_count,
+    h.regions_off, h.region_count);
+  diff = runs ? Diff(runs, index, h.frame_count) : Diff();
+}
+
+} // namespace OB
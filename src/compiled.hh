@@ -0,0 +1,69 @@
+#ifndef OB_COMPILED_HH
+#define OB_COMPILED_HH
+
+#include "mmap.hh"
+#include "plan.hh"
+#include "diff.hh"
+
+#include <string>
+#include <map>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// the binary animation format, a header table, the frame and line tables
+// of the render plan, optional diff runs, and the frame bytes,
+// laid out so that a mapped file can be played without parsing it
+//
+// tables are stored in host byte order and word size,
+// a file built on a different kind of host is rejected
+class Compiled
+{
+public:
+  // identifies the source text a compiled file was built from
+  struct Origin
+  {
+    // hash of the source path and the delimiter
+    uint64_t key {0};
+    uint64_t mtime {0};
+    uint64_t size {0};
+
+    // an edit that keeps the mtime and size still changes the ctime,
+    // or the inode when the file is replaced, and most likely the bytes
+    // at either end, which are hashed as a cheap check of the content
+    uint64_t inode {0};
+    uint64_t ctime {0};
+    uint64_t sample {0};
+
+    // whether a compiled file with this origin is still up to date with the source
+    bool matches(Origin const& source) const
+    {
+      return key == source.key && mtime == source.mtime && size == source.size &&
+        inode == source.inode && ctime == source.ctime && sample == source.sample;
+    }
+  }; // struct Origin
+
+  static Origin origin(std::string const& file_name, std::string const& delim);
+
+  // the compiled file for a source in the cache directory,
+  // empty if there is no cache directory
+  static std::string cache_path(Origin const& origin);
+
+  static bool is_compiled(Mmap const& map);
+
+  // fails if the mapping is not a valid compiled file
+  static bool read_origin(Mmap const& map, Origin& origin);
+
+  // the frames must lie back to back, as in any plan that is not interned
+  static void write(std::string const& file_name, Plan const& plan, Diff const& diff,
+    std::map<std::string, std::string> const& headers, Origin const& origin);
+
+  static void read(Mmap&& map, Plan& plan, Diff& diff, std::map<std::string, std::string>& headers);
+
+}; // class Compiled
+
+} // namespace OB
+
+#endif // OB_COMPILED_HH
@@ -0,0 +1,195 @@
+#include "diff.hh"
+#include "plan.hh"
+#include "output.hh"
+#include "source.hh"
+#include "color.hh"
+
+#include "ansi_escape_codes.hh"
+namespace AEC = OB::ANSI_Escape_Codes;
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+namespace OB
+{
+
+// unchanged cells shorter than this are rewritten,
+// as that is cheaper than emitting another cursor move
+static size_t const merge_gap {6};
+
+Diff::Diff()
+{
+}
+
+Diff::Diff(Plan const& plan)
+{
+  index_.reserve(plan.size() + 1);
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    index_.emplace_back(runs_.size());
+    size_t const prev {i > 0 ? i - 1 : plan.size() - 1};
+    compute(plan.at(prev), plan.at(i), runs_);
+  }
+  index_.emplace_back(runs_.size());
+
+  run_table_ = runs_.data();
+  index_table_ = index_.data();
+  count_ = plan.size();
+}
+
+Diff::Diff(Run const* runs, size_t const* index, size_t count) :
+  run_table_ {runs},
+  index_table_ {index},
+  count_ {count}
+{
+}
+
+Diff::~Diff()
+{
+}
+
+bool Diff::empty() const
+{
+  return index_table_ == nullptr;
+}
+
+Run const* Diff::runs() const
+{
+  return run_table_;
+}
+
+size_t const* Diff::index() const
+{
+  return index_table_;
+}
+
+size_t Diff::size() const
+{
+  return count_;
+}
+
+Run const* Diff::begin(size_t i) const
+{
+  return run_table_ + index_table_[i];
+}
+
+Run const* Diff::end(size_t i) const
+{
+  return run_table_ + index_table_[i + 1];
+}
+
+void Diff::compute(View const& prev, View const& next, std::vector<Run>& runs)
+{
+  // appends to runs
+  char const* const base {next.data};
+  size_t const rows {std::max(prev.height, next.height)};
+
+  // a cell whose color changed is written again
+  bool const styled {prev.region_count > 0 || next.region_count > 0};
+  std::vector<Style> sp;
+  std::vector<Style> sq;
+
+  for (size_t r = 0; r < rows; ++r)
+  {
+    size_t lp {0};
+    size_t lq {0};
+    char const* p {nullptr};
+    char const* q {nullptr};
+    if (r < prev.height) p = prev.line(r, lp);
+    if (r < next.height) q = next.line(r, lq);
+
+    size_t const common {std::min(lp, lq)};
+    bool open {false};
+    Run run;
+    run.row = r;
+
+    if (styled)
+    {
+      Sgr::paint(prev, r, lp, sp);
+      Sgr::paint(next, r, lq, sq);
+    }
+
+    for (size_t j = 0; j < lq; ++j)
+    {
+      if (j < common && p[j] == q[j] && (! styled || sp[j] == sq[j])) continue;
+
+      if (open && j - (run.col + run.len) < merge_gap)
+      {
+        run.len = j + 1 - run.col;
+        continue;
+      }
+
+      if (open) runs.emplace_back(run);
+      open = true;
+      run.col = j;
+      run.len = 1;
+      run.off = static_cast<size_t>(q - base) + j;
+    }
+
+    if (lq < lp)
+    {
+      if (open && lq - (run.col + run.len) < merge_gap)
+      {
+        run.len = lq - run.col;
+        run.erase = true;
+      }
+      else
+      {
+        if (open) runs.emplace_back(run);
+        open = true;
+        run.col = lq;
+        run.len = 0;
+        run.off = 0;
+        run.erase = true;
+      }
+    }
+
+    if (open) runs.emplace_back(run);
+  }
+}
+
+void Diff::encode(Output& out, View const& next, Run const* begin, Run const* end, size_t origin)
+{
+  char const* const base {next.data};
+  if (next.region_count == 0)
+  {
+    for (auto it = begin; it != end; ++it)
+    {
+      out.cursor_set(it->col + 1, it->row + origin);
+      out.append(base + it->off, it->len);
+      if (it->erase)
+      {
+        out.append(AEC::erase_end);
+      }
+    }
+    return;
+  }
+
+  // runs are written in their colors, the erase in the default one
+  Sgr sgr;
+  std::vector<Style> styles;
+  size_t row {~static_cast<size_t>(0)};
+  for (auto it = begin; it != end; ++it)
+  {
+    if (it->row != row)
+    {
+      row = it->row;
+      size_t len {0};
+      if (row < next.height) next.line(row, len);
+      Sgr::paint(next, row, len, styles);
+    }
+
+    out.cursor_set(it->col + 1, it->row + origin);
+    sgr.cells(out, base + it->off, styles.data() + it->col, it->len);
+    if (it->erase)
+    {
+      sgr.to(out, Style());
+      out.append(AEC::erase_end);
+    }
+  }
+  sgr.to(out, Style());
+}
+
+} // namespace OB
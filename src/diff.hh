@@ -0,0 +1,77 @@
+#ifndef OB_DIFF_HH
+#define OB_DIFF_HH
+
+#include "plan.hh"
+#include "output.hh"
+#include "source.hh"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace OB
+{
+
+// a run of changed cells on a single row of the next frame
+struct Run
+{
+  size_t row {0};
+  size_t col {0};
+
+  // offset of the first byte to write, relative to the start of the next frame
+  size_t off {0};
+
+  // number of bytes to write
+  size_t len {0};
+
+  // erase from the end of the run to the end of the line
+  bool erase {false};
+}; // struct Run
+
+// cell level differences between frames, a cell is a single byte
+class Diff
+{
+public:
+  Diff();
+  explicit Diff(Plan const& plan);
+
+  // runs already laid out in memory, such as in a compiled file,
+  // index holds count + 1 entries, the tables must outlive the diff
+  Diff(Run const* runs, size_t const* index, size_t count);
+
+  Diff(Diff&&) = default;
+  Diff& operator=(Diff&&) = default;
+  Diff(Diff const&) = delete;
+  Diff& operator=(Diff const&) = delete;
+  ~Diff();
+
+  // whether runs were precomputed
+  bool empty() const;
+
+  // the raw tables
+  Run const* runs() const;
+  size_t const* index() const;
+  size_t size() const;
+
+  // runs that turn frame i - 1 into frame i,
+  // the runs for frame 0 start from the last frame
+  Run const* begin(size_t i) const;
+  Run const* end(size_t i) const;
+
+  static void compute(View const& prev, View const& next, std::vector<Run>& runs);
+  static void encode(Output& out, View const& next, Run const* begin, Run const* end, size_t origin);
+
+private:
+  std::vector<Run> runs_;
+  std::vector<size_t> index_;
+
+  // either into the vectors above or into memory owned elsewhere
+  Run const* run_table_ {nullptr};
+  size_t const* index_table_ {nullptr};
+  size_t count_ {0};
+
+}; // class Diff
+
+} // namespace OB
+
+#endif // OB_DIFF_HH
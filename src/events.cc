@@ -0,0 +1,172 @@
+#include "events.hh"
+
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+#include <stdexcept>
+
+namespace OB
+{
+
+Events::Events(int fd) :
+  input_ {fd}
+{
+  // steady_clock is CLOCK_MONOTONIC, so deadlines are passed through as they are
+  timer_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (timer_ == -1)
+  {
+    throw std::runtime_error("could not create the frame timer");
+  }
+
+  sigemptyset(&mask_);
+  sigaddset(&mask_, SIGWINCH);
+  sigaddset(&mask_, SIGTERM);
+  if (pthread_sigmask(SIG_BLOCK, &mask_, &old_mask_) != 0)
+  {
+    close(timer_);
+    throw std::runtime_error("could not block signals");
+  }
+
+  signal_ = signalfd(-1, &mask_, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (signal_ == -1)
+  {
+    pthread_sigmask(SIG_SETMASK, &old_mask_, nullptr);
+    close(timer_);
+    throw std::runtime_error("could not create the signal fd");
+  }
+}
+
+Events::~Events()
+{
+  close(signal_);
+  close(timer_);
+  pthread_sigmask(SIG_SETMASK, &old_mask_, nullptr);
+}
+
+void Events::arm(Clock::time_point tp)
+{
+  if (tp == Clock::time_point::max())
+  {
+    if (! armed_) return;
+    armed_ = false;
+  }
+  else
+  {
+    if (armed_ && tp == deadline_) return;
+    armed_ = true;
+    deadline_ = tp;
+  }
+
+  itimerspec its {};
+  if (armed_)
+  {
+    auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch()).count();
+    its.it_value.tv_sec = static_cast<time_t>(ns / 1000000000);
+    its.it_value.tv_nsec = static_cast<long>(ns % 1000000000);
+
+    // a zero value disarms the timer, a deadline at or before
+    // the epoch of the clock is already due
+    if (ns <= 0)
+    {
+      its.it_value.tv_sec = 0;
+      its.it_value.tv_nsec = 1;
+    }
+  }
+
+  if (timerfd_settime(timer_, TFD_TIMER_ABSTIME, &its, nullptr) == -1)
+  {
+    throw std::runtime_error("could not set the frame timer");
+  }
+}
+
+void Events::watch(int fd)
+{
+  output_ = fd;
+}
+
+int Events::wait()
+{
+  for (;;)
+  {
+    // negative fds are skipped by poll
+    pollfd fds[4];
+    fds[0] = {timer_, POLLIN, 0};
+    fds[1] = {signal_, POLLIN, 0};
+    fds[2] = {input_, POLLIN, 0};
+    fds[3] = {output_, POLLOUT, 0};
+
+    if (poll(fds, 4, -1) == -1)
+    {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("poll failed");
+    }
+
+    int ev {0};
+
+    if (fds[0].revents & POLLIN)
+    {
+      uint64_t expired {0};
+      if (read(timer_, &expired, sizeof(expired)) == sizeof(expired))
+      {
+        armed_ = false;
+        ev |= timer;
+      }
+    }
+
+    if (fds[1].revents & POLLIN)
+    {
+      signalfd_siginfo info;
+      while (read(signal_, &info, sizeof(info)) == sizeof(info))
+      {
+        if (info.ssi_signo == SIGWINCH) ev |= resize;
+        else if (info.ssi_signo == SIGTERM) ev |= terminate;
+      }
+    }
+
+    if (input_ != -1)
+    {
+      if (fds[2].revents & POLLIN)
+      {
+        ev |= input;
+      }
+      else if (fds[2].revents & (POLLHUP | POLLERR | POLLNVAL))
+      {
+        // the terminal is gone, stop waiting on it
+        input_ = -1;
+      }
+    }
+
+    if (output_ != -1 && (fds[3].revents & (POLLOUT | POLLERR)))
+    {
+      ev |= output;
+    }
+
+    if (ev != 0) return ev;
+  }
+}
+
+bool Events::key(char& c)
+{
+  if (input_ == -1) return false;
+
+  for (;;)
+  {
+    ssize_t const num_read {read(input_, &c, 1)};
+    if (num_read == 1) return true;
+    if (num_read == -1 && errno == EINTR) continue;
+    if (num_read == -1 && errno != EAGAIN)
+    {
+      throw std::runtime_error("read failed");
+    }
+    return false;
+  }
+}
+
+} // namespace OB
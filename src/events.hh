@@ -0,0 +1,65 @@
+#ifndef OB_EVENTS_HH
+#define OB_EVENTS_HH
+
+#include <poll.h>
+#include <signal.h>
+
+#include <chrono>
+#include <cstddef>
+
+namespace OB
+{
+
+// waits on the input fd, an absolute deadline, signals
+// and an output fd becoming writable at once,
+// so that keys are handled as they arrive and an idle player sleeps in poll
+//
+// SIGWINCH and SIGTERM are blocked while the loop exists
+// and are read from a signalfd instead of being delivered
+class Events
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // bits returned by wait
+  enum : int
+  {
+    timer = 1 << 0,
+    input = 1 << 1,
+    resize = 1 << 2,
+    terminate = 1 << 3,
+    output = 1 << 4,
+  };
+
+  explicit Events(int fd);
+  Events(Events const&) = delete;
+  Events& operator=(Events const&) = delete;
+  ~Events();
+
+  // fire at the given time, the maximum time point disarms the timer
+  void arm(Clock::time_point tp);
+
+  // also wake once fd can take more bytes, -1 to stop
+  void watch(int fd);
+
+  // block until at least one event is ready
+  int wait();
+
+  // read a single key without blocking, false if there is none
+  bool key(char& c);
+
+private:
+  int input_ {-1};
+  int output_ {-1};
+  int timer_ {-1};
+  int signal_ {-1};
+  bool armed_ {false};
+  Clock::time_point deadline_;
+  sigset_t mask_;
+  sigset_t old_mask_;
+
+}; // class Events
+
+} // namespace OB
+
+#endif // OB_EVENTS_HH
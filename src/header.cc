@@ -0,0 +1,66 @@
+#include "header.hh"
+
+#include <string>
+#include <cstddef>
+
+namespace OB
+{
+
+// the characters matched by '.'
+static bool is_char(char c)
+{
+  return c != '\n' && c != '\r';
+}
+
+// the characters matched by '\s'
+static bool is_space(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+bool Header::parse(char const* data, size_t size, std::string& key, std::string& value, size_t& col)
+{
+  // the column of the first failed attempt is reported,
+  // or the end of the key if no colon follows it
+  size_t fail {0};
+
+  // try each key length in turn, shortest first
+  for (size_t k = 1; k <= size && is_char(data[k - 1]); ++k)
+  {
+    size_t j {k};
+    while (j < size && is_space(data[j])) ++j;
+    if (j == size || data[j] != ':') continue;
+
+    size_t const rest {j + 1};
+    size_t v {rest};
+    while (v < size && is_space(data[v])) ++v;
+
+    // only whitespace is left, the value is its last character
+    if (v == size && v > rest) --v;
+
+    size_t bad {v};
+    while (bad < size && is_char(data[bad])) ++bad;
+
+    if (v < size && bad == size)
+    {
+      key.assign(data, k);
+      value.assign(data + v, size - v);
+      return true;
+    }
+
+    if (fail == 0) fail = bad + 1;
+  }
+
+  if (fail == 0)
+  {
+    // end of the longest possible key
+    size_t k {0};
+    while (k < size && is_char(data[k])) ++k;
+    fail = k + 1;
+  }
+
+  col = fail;
+  return false;
+}
+
+} // namespace OB
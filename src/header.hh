@@ -0,0 +1,27 @@
+#ifndef OB_HEADER_HH
+#define OB_HEADER_HH
+
+#include <string>
+#include <cstddef>
+
+namespace OB
+{
+
+// tokenizer for 'key : value' header lines
+//
+// the grammar is that of the pattern '^(.+?)\s*:\s*(.+)$',
+// the key is the shortest non-empty prefix followed by optional whitespace
+// and a colon, the value is the rest with leading whitespace removed,
+// or the last whitespace character if only whitespace is left,
+// neither may hold a carriage return or a newline
+class Header
+{
+public:
+  // on failure, col is the 1-based column where the line stopped matching
+  static bool parse(char const* data, size_t size, std::string& key, std::string& value, size_t& col);
+
+}; // class Header
+
+} // namespace OB
+
+#endif // OB_HEADER_HH
@@ -0,0 +1,530 @@
+#include "layers.hh"
+#include "source.hh"
+#include "plan.hh"
+#include "scan.hh"
+#include "color.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OB_LAYERS_X86 1
+#include <immintrin.h>
+#else
+#define OB_LAYERS_X86 0
+#endif
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace OB
+{
+
+namespace
+{
+
+char const keyword[] {"LAYER"};
+size_t const keyword_size {sizeof(keyword) - 1};
+
+char const delay_keyword[] {"DELAY"};
+size_t const delay_keyword_size {sizeof(delay_keyword) - 1};
+
+bool is_layer(char const* data, size_t len)
+{
+  return len >= keyword_size && std::memcmp(data, keyword, keyword_size) == 0 &&
+    (len == keyword_size || data[keyword_size] == ' ');
+}
+
+bool is_delay(char const* data, size_t len)
+{
+  return len >= delay_keyword_size && std::memcmp(data, delay_keyword, delay_keyword_size) == 0 &&
+    (len == delay_keyword_size || data[delay_keyword_size] == ' ');
+}
+
+// the milliseconds of a delay line, a single number of at least 1
+size_t parse_delay(char const* data, size_t len, size_t frame, size_t line)
+{
+  size_t pos {delay_keyword_size};
+  while (pos < len && data[pos] == ' ') ++pos;
+  size_t end {len};
+  while (end > pos && data[end - 1] == ' ') --end;
+
+  size_t ms {0};
+  bool ok {pos < end && end - pos <= 9};
+  for (size_t j = pos; ok && j < end; ++j)
+  {
+    ok = data[j] >= '0' && data[j] <= '9';
+    ms = ms * 10 + static_cast<size_t>(data[j] - '0');
+  }
+
+  if (! ok || ms == 0)
+  {
+    throw std::runtime_error("invalid delay at frame " + std::to_string(frame + 1) + ", line " + std::to_string(line + 1));
+  }
+  return ms;
+}
+
+void blend_scalar(char* dst, char const* src, size_t size, char clear)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    if (src[i] != clear) dst[i] = src[i];
+  }
+}
+
+#if OB_LAYERS_X86
+
+__attribute__((target("sse2")))
+void blend_sse2(char* dst, char const* src, size_t size, char clear)
+{
+  __m128i const t {_mm_set1_epi8(clear)};
+  size_t i {0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i const s {_mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i))};
+    __m128i const d {_mm_loadu_si128(reinterpret_cast<__m128i const*>(dst + i))};
+    __m128i const m {_mm_cmpeq_epi8(s, t)};
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s)));
+  }
+  blend_scalar(dst + i, src + i, size - i, clear);
+}
+
+__attribute__((target("avx2")))
+void blend_avx2(char* dst, char const* src, size_t size, char clear)
+{
+  __m256i const t {_mm256_set1_epi8(clear)};
+  size_t i {0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i const s {_mm256_loadu_si256(reinterpret_cast<__m256i const*>(src + i))};
+    __m256i const d {_mm256_loadu_si256(reinterpret_cast<__m256i const*>(dst + i))};
+    __m256i const m {_mm256_cmpeq_epi8(s, t)};
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_blendv_epi8(s, d, m));
+  }
+  blend_scalar(dst + i, src + i, size - i, clear);
+}
+
+#endif
+
+} // namespace
+
+Plan Layers::flatten(Plan const& plan)
+{
+  Layers layers;
+  std::vector<std::string> frames (plan.size());
+  std::vector<std::vector<Region>> regions (plan.size());
+  std::vector<size_t> delays (plan.size());
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    View const v {plan.at(i)};
+    if (! layers.compose(i, v, frames[i], regions[i]))
+    {
+      frames[i].assign(v.data, v.size);
+    }
+    delays[i] = layers.delay();
+  }
+  return Plan(frames, regions, delays);
+}
+
+void Layers::blend(char* dst, char const* src, size_t size, char clear)
+{
+  static Scan::Kernel const k {Scan::kernel()};
+  blend(k, dst, src, size, clear);
+}
+
+void Layers::blend(Scan::Kernel k, char* dst, char const* src, size_t size, char clear)
+{
+  switch (k)
+  {
+#if OB_LAYERS_X86
+    case Scan::Kernel::avx2:
+      blend_avx2(dst, src, size, clear);
+      return;
+    case Scan::Kernel::sse2:
+      blend_sse2(dst, src, size, clear);
+      return;
+#endif
+    case Scan::Kernel::scalar:
+    default:
+      blend_scalar(dst, src, size, clear);
+      return;
+  }
+}
+
+bool Layers::compose(size_t i, View const& v, std::string& out, std::vector<Region>& regions)
+{
+  parse(i, v);
+  if (plain_ && held_.empty()) return false;
+  update();
+  regions = regions_;
+
+  // the held layers are stacked with the rest of the frame,
+  // the run of held layers at the bottom is the cached background
+  stack_.clear();
+  for (auto& e : held_)
+  {
+    e.layer.base = e.data.data();
+    stack_.emplace_back(&e.layer, true);
+  }
+  for (auto const& e : own_)
+  {
+    if (! e.hold) stack_.emplace_back(&e, false);
+  }
+  std::stable_sort(stack_.begin(), stack_.end(), [](std::pair<Layer const*, bool> const& a, std::pair<Layer const*, bool> const& b)
+  {
+    return a.first->z < b.first->z;
+  });
+
+  size_t count {0};
+  while (count < stack_.size() && stack_[count].second) ++count;
+
+  if (bg_gen_ != gen_ || bg_count_ != count)
+  {
+    size_t width {0};
+    size_t height {0};
+    for (size_t j = 0; j < count; ++j)
+    {
+      width = std::max(width, stack_[j].first->width);
+      height = std::max(height, stack_[j].first->rows.size());
+    }
+    bg_.clear(width, height);
+    for (size_t j = 0; j < count; ++j)
+    {
+      bg_.draw(*stack_[j].first);
+    }
+    bg_gen_ = gen_;
+    bg_count_ = count;
+  }
+
+  size_t width {bg_.width};
+  size_t height {bg_.height};
+  for (size_t j = count; j < stack_.size(); ++j)
+  {
+    width = std::max(width, stack_[j].first->width);
+    height = std::max(height, stack_[j].first->rows.size());
+  }
+  grid_.clear(width, height);
+  for (size_t r = 0; r < bg_.height; ++r)
+  {
+    std::memcpy(grid_.cells.data() + r * width, bg_.cells.data() + r * bg_.width, bg_.width);
+  }
+  for (size_t j = count; j < stack_.size(); ++j)
+  {
+    grid_.draw(*stack_[j].first);
+  }
+
+  // empty cells are spaces, except at the end of a row
+  out.clear();
+  out.reserve((width + 1) * height);
+  for (size_t r = 0; r < height; ++r)
+  {
+    char const* const row {grid_.cells.data() + r * width};
+    size_t len {width};
+    while (len > 0 && row[len - 1] == '\0') --len;
+    size_t const begin {out.size()};
+    out.append(row, len);
+    std::replace(out.begin() + static_cast<std::ptrdiff_t>(begin), out.end(), '\0', ' ');
+    if (r + 1 < height) out += '\n';
+  }
+
+  return true;
+}
+
+void Layers::skip(size_t i, View const& v)
+{
+  parse(i, v);
+  if (plain_ && held_.empty()) return;
+  update();
+}
+
+size_t Layers::delay() const
+{
+  return delay_;
+}
+
+void Layers::reset()
+{
+  held_.clear();
+  delay_ = 0;
+  ++gen_;
+}
+
+void Layers::save(State& state) const
+{
+  state.held = held_;
+  state.delay = delay_;
+}
+
+void Layers::restore(State const& state)
+{
+  held_ = state.held;
+  delay_ = state.delay;
+  ++gen_;
+}
+
+void Layers::parse(size_t i, View const& v)
+{
+  own_.clear();
+  regions_.clear();
+  plain_ = true;
+
+  for (size_t r = 0; r < v.height; ++r)
+  {
+    size_t len {0};
+    char const* const line {v.line(r, len)};
+
+    if (Sgr::is_color(line, len))
+    {
+      plain_ = false;
+      regions_.emplace_back(Sgr::parse(line, len, i, r));
+      continue;
+    }
+
+    if (is_delay(line, len))
+    {
+      plain_ = false;
+      delay_ = parse_delay(line, len, i, r);
+      continue;
+    }
+
+    if (is_layer(line, len))
+    {
+      plain_ = false;
+      Layer layer;
+      layer.base = v.data;
+
+      // the tokens after the keyword, z, then an optional character and 'hold'
+      size_t field {0};
+      size_t pos {keyword_size};
+      while (pos < len)
+      {
+        while (pos < len && line[pos] == ' ') ++pos;
+        if (pos == len) break;
+        size_t end {pos};
+        while (end < len && line[end] != ' ') ++end;
+        std::string const token (line + pos, end - pos);
+
+        bool ok {true};
+        if (field == 0)
+        {
+          size_t used {0};
+          try
+          {
+            layer.z = std::stoll(token, &used);
+          }
+          catch (std::exception const&)
+          {
+            ok = false;
+          }
+          ok = ok && used == token.size();
+        }
+        else if (token == "hold" && ! layer.hold)
+        {
+          layer.hold = true;
+        }
+        else if (field == 1 && token.size() == 1)
+        {
+          layer.clear = token[0];
+        }
+        else
+        {
+          ok = false;
+        }
+
+        if (! ok)
+        {
+          throw std::runtime_error("invalid layer at frame " + std::to_string(i + 1) + ", line " + std::to_string(r + 1));
+        }
+        ++field;
+        pos = end;
+      }
+
+      if (field == 0)
+      {
+        throw std::runtime_error("invalid layer at frame " + std::to_string(i + 1) + ", line " + std::to_string(r + 1));
+      }
+
+      own_.emplace_back(std::move(layer));
+      continue;
+    }
+
+    // text before the first layer line
+    if (own_.empty())
+    {
+      Layer layer;
+      layer.base = v.data;
+      own_.emplace_back(std::move(layer));
+    }
+
+    auto& layer = own_.back();
+    Row row;
+    row.off = static_cast<size_t>(line - v.data);
+    row.len = len;
+    layer.rows.emplace_back(row);
+    layer.width = std::max(layer.width, len);
+  }
+}
+
+void Layers::update()
+{
+  // a layer replaces the held layer with the same z
+  for (auto const& e : own_)
+  {
+    auto const it = std::find_if(held_.begin(), held_.end(), [&](Held const& h) { return h.layer.z == e.z; });
+    if (it != held_.end())
+    {
+      held_.erase(it);
+      ++gen_;
+    }
+
+    if (! e.hold) continue;
+
+    Held h;
+    h.layer = e;
+    for (auto& row : h.layer.rows)
+    {
+      size_t const off {h.data.size()};
+      h.data.append(e.base + row.off, row.len);
+      row.off = off;
+    }
+    h.layer.base = nullptr;
+    held_.emplace_back(std::move(h));
+    ++gen_;
+  }
+}
+
+void Layers::Grid::clear(size_t w, size_t h)
+{
+  width = w;
+  height = h;
+  cells.assign(w * h, '\0');
+}
+
+void Layers::Grid::draw(Layer const& layer)
+{
+  for (size_t r = 0; r < layer.rows.size() && r < height; ++r)
+  {
+    auto const& row = layer.rows[r];
+    blend(cells.data() + r * width, layer.base + row.off, std::min(row.len, width), layer.clear);
+  }
+}
+
+size_t const Layered::key_interval {64};
+
+Layered::Layered(Source& src) :
+  src_ {src}
+{
+}
+
+size_t Layered::size() const
+{
+  return src_.size();
+}
+
+bool Layered::view(size_t i, View& v)
+{
+  // the frame on screen is asked for again on a redraw
+  if (i + 1 == next_)
+  {
+    v = last_;
+    return true;
+  }
+
+  // going back replays the held layers from the keyframe before the frame
+  if (i < next_)
+  {
+    size_t const key {i / key_interval};
+    if (key < key_first_)
+    {
+      layers_.reset();
+      next_ = 0;
+    }
+    else
+    {
+      layers_.restore(keys_.at(key - key_first_));
+      next_ = key * key_interval;
+    }
+  }
+
+  bool const skipped {next_ < i};
+  View raw;
+  for (; next_ < i; ++next_)
+  {
+    keyframe();
+    if (src_.view(next_, raw)) layers_.skip(next_, raw);
+  }
+
+  keyframe();
+  if (! src_.view(i, raw)) return false;
+  next_ = i + 1;
+
+  // viewing skipped frames may have dropped the frame before from the source,
+  // so anything but an unchanged frame in sequence is copied
+  slot_ ^= 1;
+  auto& slot = slots_[slot_];
+  slot.regions.clear();
+  if (! layers_.compose(i, raw, slot.data, slot.regions))
+  {
+    if (! skipped)
+    {
+      v = raw;
+      v.delay = layers_.delay();
+      last_ = v;
+      return true;
+    }
+    slot.data.assign(raw.data, raw.size);
+  }
+
+  slot.lines.clear();
+  v = View();
+  v.data = slot.data.data();
+  v.size = slot.data.size();
+  Plan::measure(v.data, v.size, v.height, v.width, slot.lines);
+  v.lines = slot.lines.data();
+  v.regions = slot.regions.data();
+  v.region_count = slot.regions.size();
+  v.delay = layers_.delay();
+  last_ = v;
+  return true;
+}
+
+bool Layered::seekable(size_t i) const
+{
+  if (i + 1 == next_) return true;
+
+  // every frame from where the layers are replayed has to be viewed
+  size_t from {next_};
+  if (i < next_)
+  {
+    size_t const key {i / key_interval};
+    from = key < key_first_ ? 0 : key * key_interval;
+  }
+  return src_.seekable(from) && src_.seekable(i);
+}
+
+void Layered::prefetch()
+{
+  src_.prefetch();
+}
+
+void Layered::keyframe()
+{
+  if (next_ % key_interval != 0 || next_ / key_interval != key_first_ + keys_.size()) return;
+  keys_.emplace_back();
+  layers_.save(keys_.back());
+
+  // a stream keeps only the frames around the one on screen,
+  // so an endless one would otherwise grow the keyframes without bound
+  size_t drop {0};
+  while (drop + 1 < keys_.size() && ! src_.seekable((key_first_ + drop) * key_interval))
+  {
+    ++drop;
+  }
+  keys_.erase(keys_.begin(), keys_.begin() + static_cast<std::ptrdiff_t>(drop));
+  key_first_ += drop;
+}
+
+} // namespace OB
@@ -0,0 +1,172 @@
+#ifndef OB_LAYERS_HH
+#define OB_LAYERS_HH
+
+#include "source.hh"
+#include "plan.hh"
+#include "scan.hh"
+#include "color.hh"
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// frames built from layers, each starts at a line of the form
+// 'LAYER z [c] [hold]' and runs until the next one or the end of the frame,
+// text before the first layer line is layer 0,
+// layers are stacked by z, lowest first, in order of appearance for equal z,
+// and c, a space unless given, is the transparent character,
+// a held layer stays in the following frames until a frame declares a layer
+// with the same z, the held layers are dropped at the start of every loop,
+// color directives are taken out of the frame and apply to the composite,
+// and so are lines of the form 'DELAY ms', which set how long the frame
+// and the ones after it stay on screen, until the next one or the end of the loop
+class Layers
+{
+public:
+  // the same plan with every frame composited, in order
+  static Plan flatten(Plan const& plan);
+
+  // overwrite dst with the cells of src that are not clear
+  static void blend(char* dst, char const* src, size_t size, char clear);
+  static void blend(Scan::Kernel k, char* dst, char const* src, size_t size, char clear);
+
+  // composite frame i, which follows the frame given last, into out,
+  // with the color regions of the frame replacing regions,
+  // returns false if the frame is unchanged and neither is touched
+  bool compose(size_t i, View const& v, std::string& out, std::vector<Region>& regions);
+
+  // only take the held layers from a frame that is not shown
+  void skip(size_t i, View const& v);
+
+  // the delay of the frame given last in milliseconds, 0 for the default
+  size_t delay() const;
+
+  // drop the held layers and the delay
+  void reset();
+
+  // what carries over from a frame to the next, the held layers and the delay
+  struct State;
+  void save(State& state) const;
+  void restore(State const& state);
+
+private:
+  struct Row
+  {
+    size_t off {0};
+    size_t len {0};
+  }; // struct Row
+
+  struct Layer
+  {
+    int64_t z {0};
+    char clear {' '};
+    bool hold {false};
+
+    // rows are relative to base
+    char const* base {nullptr};
+    std::vector<Row> rows;
+    size_t width {0};
+  }; // struct Layer
+
+  // a held layer owns a copy of its rows
+  struct Held
+  {
+    Layer layer;
+    std::string data;
+  }; // struct Held
+
+  // a cell grid, empty cells hold a null character
+  struct Grid
+  {
+    size_t width {0};
+    size_t height {0};
+    std::vector<char> cells;
+
+    void clear(size_t w, size_t h);
+    void draw(Layer const& layer);
+  }; // struct Grid
+
+  std::vector<Held> held_;
+  std::vector<Layer> own_;
+  std::vector<Region> regions_;
+  // the layers of the frame in z order, and whether each is held
+  std::vector<std::pair<Layer const*, bool>> stack_;
+
+  // the composite of the held layers under the layers of the frame,
+  // rebuilt only when they change
+  Grid bg_;
+  uint64_t gen_ {0};
+  uint64_t bg_gen_ {~static_cast<uint64_t>(0)};
+  size_t bg_count_ {0};
+
+  Grid grid_;
+
+  // whether the frame parsed last has no layer, color or delay lines
+  bool plain_ {true};
+
+  // set by the last delay line seen
+  size_t delay_ {0};
+
+  void parse(size_t i, View const& v);
+  void update();
+
+}; // class Layers
+
+struct Layers::State
+{
+  std::vector<Held> held;
+  size_t delay {0};
+}; // struct State
+
+// composites the frames of another source as they are requested,
+// for sources that can not be flattened at load time, such as a stream
+class Layered : public Source
+{
+public:
+  explicit Layered(Source& src);
+
+  size_t size() const override;
+  bool view(size_t i, View& v) override;
+  bool seekable(size_t i) const override;
+  void prefetch() override;
+
+private:
+  Source& src_;
+  Layers layers_;
+
+  // the next frame in sequence, skipped frames still pass on their held layers
+  size_t next_ {0};
+
+  // the state before every key_interval-th frame from key key_first_ on,
+  // so that going back only replays the frames since the last keyframe
+  // instead of the whole loop, keyframes the source can no longer seek to are
+  // dropped, going back past them replays from the start of the loop
+  static size_t const key_interval;
+  std::vector<Layers::State> keys_;
+  size_t key_first_ {0};
+
+  void keyframe();
+
+  // the last two frames handed out
+  struct Slot
+  {
+    std::string data;
+    std::vector<size_t> lines;
+    std::vector<Region> regions;
+  }; // struct Slot
+  Slot slots_[2];
+  size_t slot_ {0};
+
+  // the view of frame next_ - 1
+  View last_;
+
+}; // class Layered
+
+} // namespace OB
+
+#endif // OB_LAYERS_HH
@@ -44,7 +44,10 @@ int program_options(Parg& pg)
   pg.name("asciimation").version("0.4.0 (03.04.2018)");
   pg.description("ascii animation interpreter");
   pg.usage("[flags] [options] [--] [arguments]");
-  pg.usage("[-f|--file input_file] [-d|--delim delim] [-t|--time time_delay_ms] [-l|--loop loop_number] [--debug]");
+  pg.usage("[-f|--file input_file] [-d|--delim delim] [-t|--time time_delay_ms] [-l|--loop loop_number] [--start-frame frame|--start-time seconds] [--render full|diff] [--skip drop|catchup|none] [--buffer frames] [--memory MiB] [--ahead frames] [--stream-loop spill|retain] [--cache] [--stats file_name] [--trace file_name] [--debug]");
+  pg.usage("[-f|--file input_file] [-o|--output output_file|null|vt] [--no-tty] [--render full|diff] [-l|--loop loop_number] [--debug]");
+  pg.usage("[-f|--file input_file] [--tty tty[,tty...]] [--socket socket_file] [--no-tty] [--render full|diff] [-l|--loop loop_number] [--debug]");
+  pg.usage("[--compile input_file] [-o|--output output_file] [-d|--delim delim]");
   pg.usage("[-v|--version]");
   pg.usage("[-h|--help]");
   pg.info("Runtime Keybindings", {
@@ -55,11 +58,24 @@ int program_options(Parg& pg)
     "J -> decrease speed by 50",
     "k -> increase speed by 5",
     "K -> increase speed by 50",
-    "space -> pause the animation",
+    "space -> pause or resume the animation",
+    ", -> step back a frame",
+    ". -> step forward a frame",
+    "0-9 -> seek to a tenth of the loop",
+    "g -> seek to the first frame",
+    "G -> seek to the last frame",
+    "r -> toggle reverse playback",
   });
   pg.info("Exit Codes", {"0 -> normal", "1 -> error"});
   pg.info("Examples", {
     "asciimation -f './test' -d 'END' -t 80 -l 3",
+    "generator | asciimation -f - -l 1",
+    "asciimation --compile './test' -o './test.asc' -d 'END'",
+    "asciimation -f './test.asc'",
+    "asciimation -f './test' --render diff -o null",
+    "asciimation -f './test' -o vt -l 1",
+    "asciimation -f './test' --start-time 12.5",
+    "asciimation -f './test' --tty /dev/pts/3,/dev/ttyS0 --socket /tmp/test.sock",
     "asciimation --help",
     "asciimation --version",
   });
@@ -68,10 +84,26 @@ int program_options(Parg& pg)
   pg.set("help,h", "print the help output");
   pg.set("version,v", "print the program version");
 
-  pg.set("file,f", "", "file_name", "the input file");
+  pg.set("file,f", "", "file_name", "the input file, '-' reads from stdin, pipes and other files that can not be mapped are streamed");
   pg.set("delim,d", "END", "str", "the frame delimiter");
-  pg.set("time,t", "250", "int", "the time delay between frames in milliseconds");
-  pg.set("debug", "show debug output");
+  pg.set("time,t", "250", "int", "the time delay between frames in milliseconds, for frames without a DELAY line");
+  pg.set("start-frame", "0", "int", "the frame to start at, counting from 1");
+  pg.set("start-time", "0", "seconds", "the point in the first loop to start at, taking the frame delays into account");
+  pg.set("render", "full", "full|diff", "the render mode, 'full' repaints every frame, 'diff' only redraws the cells that changed");
+  pg.set("skip", "drop", "drop|catchup|none", "what to do when playback falls behind, 'drop' skips to the frame that is due and skips frames the terminal can not keep up with, 'catchup' shows the late frames back to back, 'none' shows every frame and lets the animation run late");
+  pg.set("buffer", "16", "int", "the number of parsed frames held in memory when streaming, or unpacked ahead of playback when packed");
+  pg.set("memory", "0", "MiB", "the memory budget for the frames, larger animations are kept delta compressed in memory, 0 for no limit");
+  pg.set("ahead", "4", "int", "the number of frames rendered ahead on a second thread in diff mode, 0 renders every frame on the main thread");
+  pg.set("stream-loop", "spill", "spill|retain", "how a stream is kept for the next loop, 'spill' writes it to a temporary file, 'retain' keeps it in memory");
+  pg.set("compile", "", "file_name", "compile the input file into the binary format and exit, a compiled file is played like any other input file");
+  pg.set("output,o", "", "file_name", "with --compile, the compiled output file, defaults to the input file name with '.asc' appended, otherwise play headless into the file, 'null' for /dev/null or 'vt' for an in-memory terminal whose final screen is printed, the throughput is reported on stderr");
+  pg.set("no-tty", "play headless without a terminal, as fast as possible, to stdout unless --output is set, a loop number of 0 plays once");
+  pg.set("tty", "", "tty[,tty...]", "also play to each of these terminals, every frame is rendered once and written to all of them without waiting, a terminal that falls behind is skipped and sent a whole frame once it has caught up");
+  pg.set("socket", "", "file_name", "also play to every client that connects to a unix socket created at this path, such as 'socat - UNIX-CONNECT:file_name', with --no-tty only to the terminals and clients");
+  pg.set("cache", "keep a compiled copy of the input file in the cache directory and play it on later launches");
+  pg.set("stats", "", "file_name", "write the frame timing histograms and how much repeated rows and frames were deduplicated as json on exit");
+  pg.set("trace", "", "file_name", "write when each stage of the player ran as a chrome trace on exit, open it in chrome://tracing or perfetto");
+  pg.set("debug", "show debug output, loops left | delay | frame | time | bytes | render, write and jitter time of the last frame in microseconds | rolling p50 and p99 of the same | frames dropped to stay on time and those not sent to a terminal that could not keep up");
   pg.set("loop,l", "0", "int", "set the animation to loop n times, if n is 0, it will loop infinitely");
 
   int status {pg.parse()};
@@ -103,6 +135,7 @@ int program_options(Parg& pg)
 int main(int argc, char *argv[])
 {
   Parg pg {argc, argv};
+  pg.set_stdin(false);
   int pstatus {program_options(pg)};
   if (pstatus > 0) return 0;
   if (pstatus < 0) return 1;
@@ -115,7 +148,29 @@ int main(int argc, char *argv[])
     am.set_debug(pg.get<bool>("debug"));
     am.set_loop(pg.get<size_t>("loop"));
     am.set_delay(pg.get<size_t>("time"));
+    am.set_start_frame(pg.get<size_t>("start-frame"));
+    am.set_start_time(pg.get<double>("start-time"));
+    am.set_render(pg.get("render"));
+    am.set_skip(pg.get("skip"));
+    am.set_buffer(pg.get<size_t>("buffer"));
+    am.set_memory(pg.get<size_t>("memory"));
+    am.set_ahead(pg.get<size_t>("ahead"));
+    am.set_stream_loop(pg.get("stream-loop"));
     am.set_delim(pg.get("delim"));
+    am.set_cache(pg.get<bool>("cache"));
+
+    if (! pg.get("compile").empty())
+    {
+      am.compile(pg.get("compile"), pg.get("output"));
+      return 0;
+    }
+
+    am.set_stats(pg.get("stats"));
+    am.set_trace(pg.get("trace"));
+    am.set_output(pg.get("output"));
+    am.set_tty(! pg.get<bool>("no-tty"));
+    am.set_ttys(pg.get("tty"));
+    am.set_socket(pg.get("socket"));
     am.run(pg.get("file"));
   }
   catch (std::exception const& e)
@@ -0,0 +1,114 @@
+#include "mmap.hh"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+
+namespace OB
+{
+
+Mmap::Mmap()
+{
+}
+
+Mmap::Mmap(std::string const& file_name)
+{
+  int const fd {open(file_name.c_str(), O_RDONLY | O_CLOEXEC)};
+  if (fd == -1)
+  {
+    throw std::runtime_error("could not open input file");
+  }
+
+  try
+  {
+    map(fd);
+  }
+  catch (...)
+  {
+    close(fd);
+    throw;
+  }
+
+  close(fd);
+}
+
+Mmap::Mmap(int fd)
+{
+  map(fd);
+}
+
+Mmap::Mmap(Mmap&& other) :
+  data_ {other.data_},
+  size_ {other.size_}
+{
+  other.data_ = nullptr;
+  other.size_ = 0;
+}
+
+Mmap& Mmap::operator=(Mmap&& other)
+{
+  if (this != &other)
+  {
+    reset();
+    data_ = other.data_;
+    size_ = other.size_;
+    other.data_ = nullptr;
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+Mmap::~Mmap()
+{
+  reset();
+}
+
+char const* Mmap::data() const
+{
+  return data_;
+}
+
+size_t Mmap::size() const
+{
+  return size_;
+}
+
+void Mmap::reset()
+{
+  if (data_ != nullptr)
+  {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+void Mmap::map(int fd)
+{
+  struct stat st;
+  if (fstat(fd, &st) == -1 || ! S_ISREG(st.st_mode))
+  {
+    throw std::runtime_error("input file is not a regular file");
+  }
+
+  size_t const size {static_cast<size_t>(st.st_size)};
+
+  // an empty file can not be mapped, it is left as an empty range
+  if (size > 0)
+  {
+    void* ptr {mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+    if (ptr == MAP_FAILED)
+    {
+      throw std::runtime_error("could not map input file");
+    }
+    data_ = static_cast<char const*>(ptr);
+    size_ = size;
+  }
+}
+
+} // namespace OB
@@ -0,0 +1,41 @@
+#ifndef OB_MMAP_HH
+#define OB_MMAP_HH
+
+#include <string>
+#include <cstddef>
+
+namespace OB
+{
+
+// read-only memory mapping of a whole file
+class Mmap
+{
+public:
+  Mmap();
+  explicit Mmap(std::string const& file_name);
+
+  // the descriptor is not closed
+  explicit Mmap(int fd);
+  Mmap(Mmap&& other);
+  Mmap& operator=(Mmap&& other);
+  Mmap(Mmap const&) = delete;
+  Mmap& operator=(Mmap const&) = delete;
+  ~Mmap();
+
+  char const* data() const;
+  size_t size() const;
+
+  // release the mapping
+  void reset();
+
+private:
+  char const* data_ {nullptr};
+  size_t size_ {0};
+
+  void map(int fd);
+
+}; // class Mmap
+
+} // namespace OB
+
+#endif // OB_MMAP_HH
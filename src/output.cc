@@ -0,0 +1,473 @@
+#include "output.hh"
+
+#include "ansi_escape_codes.hh"
+namespace AEC = OB::ANSI_Escape_Codes;
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+
+namespace OB
+{
+
+// segments per writev call, well below IOV_MAX
+static size_t const iov_max {64};
+
+// the bursts written to measure a terminal, a few hundred bytes in all,
+// starting small so that a slow line is not handed more than it can take in time
+static size_t const probe_min {64};
+static size_t const probe_max {256};
+
+// how long the last bytes are waited for on exit
+static std::chrono::milliseconds const exit_wait {250};
+
+// unix98 pty slaves, whose driver queue TIOCOUTQ always reads as empty
+static unsigned int const pty_major_min {136};
+static unsigned int const pty_major_max {143};
+
+// how much a new measurement of the rate of a terminal counts
+static double const rate_weight {0.25};
+
+Fd_Sink::Fd_Sink(int fd) :
+  fd_ {fd}
+{
+}
+
+Fd_Sink::Fd_Sink(std::string const& file_name) :
+  fd_ {open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)},
+  owned_ {true}
+{
+  if (fd_ == -1)
+  {
+    throw std::runtime_error("could not open output file");
+  }
+}
+
+Fd_Sink::~Fd_Sink()
+{
+  if (owned_)
+  {
+    close(fd_);
+  }
+}
+
+int Fd_Sink::fd() const
+{
+  return fd_;
+}
+
+void Fd_Sink::write(struct iovec* iov, size_t cnt)
+{
+  while (cnt > 0)
+  {
+    ssize_t const num {writev(fd_, iov, static_cast<int>(cnt))};
+
+    if (num < 0)
+    {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("write failed");
+    }
+
+    // skip past what was written, partial writes resume mid segment
+    auto left = static_cast<size_t>(num);
+    while (cnt > 0 && left >= iov->iov_len)
+    {
+      left -= iov->iov_len;
+      ++iov;
+      --cnt;
+    }
+    if (cnt > 0)
+    {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+      iov->iov_len -= left;
+    }
+  }
+}
+
+Tty_Sink::Tty_Sink(int fd) :
+  fd_ {fd}
+{
+  char const* const name {isatty(fd) ? ttyname(fd) : nullptr};
+  if (name == nullptr) return;
+
+  int const tty {open(name, O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)};
+  if (tty == -1) return;
+
+  fd_ = tty;
+  owned_ = true;
+
+  struct stat st;
+  if (fstat(fd_, &st) == 0 && S_ISCHR(st.st_mode))
+  {
+    unsigned int const num {major(st.st_rdev)};
+    visible_ = num < pty_major_min || num > pty_major_max;
+  }
+}
+
+Tty_Sink::~Tty_Sink()
+{
+  // the last bytes, such as clearing the screen on exit, are waited for a moment,
+  // a stalled terminal does not hold up the exit, and a failing one is given up on
+  try
+  {
+    wait(Clock::now() + exit_wait);
+  }
+  catch (...)
+  {
+  }
+
+  if (owned_)
+  {
+    close(fd_);
+  }
+}
+
+int Tty_Sink::fd() const
+{
+  return fd_;
+}
+
+void Tty_Sink::write(struct iovec* iov, size_t cnt)
+{
+  // queued behind anything still pending, to keep the order
+  size_t skip {0};
+  if (drain())
+  {
+    skip = put(iov, cnt);
+  }
+
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    if (skip >= iov[i].iov_len)
+    {
+      skip -= iov[i].iov_len;
+      continue;
+    }
+    pending_.append(static_cast<char const*>(iov[i].iov_base) + skip, iov[i].iov_len - skip);
+    skip = 0;
+  }
+
+  // a descriptor that is no terminal is waited on up to the deadline,
+  // past it what is left is drained like that of a terminal
+  if (! owned_)
+  {
+    wait(deadline_);
+  }
+}
+
+void Tty_Sink::set_deadline(Clock::time_point tp)
+{
+  deadline_ = tp;
+}
+
+bool Tty_Sink::drain()
+{
+  if (pending_.empty()) return true;
+
+  struct iovec iov {&pending_[0], pending_.size()};
+  pending_.erase(0, put(&iov, 1));
+  return pending_.empty();
+}
+
+bool Tty_Sink::pending() const
+{
+  return ! pending_.empty();
+}
+
+size_t Tty_Sink::queued()
+{
+  size_t const num {outq()};
+  size_t const taken {sent_ > num ? sent_ - num : 0};
+  size_t const total {num + pending_.size()};
+  auto const now = Clock::now();
+
+  // only while the terminal had something to take the whole time
+  // does what it took measure how fast it goes
+  if (busy_ && total > 0 && now > seen_)
+  {
+    double const secs {std::chrono::duration<double>(now - seen_).count()};
+    double const rate {static_cast<double>(taken > taken_ ? taken - taken_ : 0) / secs};
+    rate_ = rate_ > 0 ? rate_ + (rate - rate_) * rate_weight : rate;
+  }
+
+  taken_ = taken;
+  seen_ = now;
+  busy_ = total > 0;
+
+  return total;
+}
+
+bool Tty_Sink::late(Clock::time_point tp)
+{
+  size_t const num {queued()};
+  if (num == 0) return false;
+
+  // the driver is full, a pty tells nothing more than that
+  if (! pending_.empty()) return true;
+  if (rate_ <= 0) return false;
+
+  auto const now = Clock::now();
+  double const secs {tp > now ? std::chrono::duration<double>(tp - now).count() : 0.0};
+  return static_cast<double>(num) > rate_ * secs;
+}
+
+void Tty_Sink::probe(Clock::duration limit)
+{
+  // without a queue to watch the rate is only learnt from a full driver
+  if (! visible_) return;
+
+  auto const start = Clock::now();
+  auto const end = start + limit;
+  size_t const sent {sent_ - outq()};
+
+  // whether any burst was seen waiting in the driver
+  bool seen {false};
+
+  std::string buf;
+  for (size_t size = probe_min; size <= probe_max && Clock::now() < end; size *= 2)
+  {
+    while (buf.size() < size)
+    {
+      buf.append(AEC::cursor_home.data, AEC::cursor_home.size);
+    }
+    struct iovec iov {&buf[0], buf.size()};
+    write(&iov, 1);
+
+    seen = seen || queued() > 0;
+
+    // wait for the terminal to take all of it, pending bytes as room frees up,
+    // the queue of the driver as it empties
+    while (queued() > 0 && Clock::now() < end)
+    {
+      struct pollfd pfd {fd_, POLLOUT, 0};
+      poll(pending_.empty() ? nullptr : &pfd, pending_.empty() ? 0 : 1, 1);
+      drain();
+    }
+    if (queued() > 0) break;
+  }
+
+  // a driver that took every burst whole and never showed a queue hides it
+  if (! seen)
+  {
+    visible_ = false;
+    return;
+  }
+
+  double const secs {std::chrono::duration<double>(Clock::now() - start).count()};
+  size_t const taken {sent_ - outq() - sent};
+  if (secs > 0 && taken > 0)
+  {
+    rate_ = static_cast<double>(taken) / secs;
+  }
+}
+
+bool Tty_Sink::wait(Clock::time_point tp)
+{
+  while (! drain())
+  {
+    auto const now = Clock::now();
+    if (now >= tp) return false;
+
+    int ms {-1};
+    if (tp != Clock::time_point::max())
+    {
+      auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(tp - now).count() + 1;
+      ms = static_cast<int>(std::min<int64_t>(left, std::numeric_limits<int>::max()));
+    }
+
+    struct pollfd pfd {fd_, POLLOUT, 0};
+    if (poll(&pfd, 1, ms) == -1)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) return false;
+  }
+  return true;
+}
+
+size_t Tty_Sink::put(struct iovec const* iov, size_t cnt)
+{
+  for (;;)
+  {
+    ssize_t const num {writev(fd_, iov, static_cast<int>(cnt))};
+    if (num >= 0)
+    {
+      sent_ += static_cast<size_t>(num);
+      return static_cast<size_t>(num);
+    }
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN) return 0;
+    throw std::runtime_error("write failed");
+  }
+}
+
+size_t Tty_Sink::outq() const
+{
+  int num {0};
+  if (! visible_ || ioctl(fd_, TIOCOUTQ, &num) == -1 || num < 0) return 0;
+  return static_cast<size_t>(num);
+}
+
+Output::Output(int fd) :
+  fd_ {fd},
+  sink_ {&fd_}
+{
+  buf_.reserve(4096);
+}
+
+Output::Output(Sink& sink) :
+  sink_ {&sink}
+{
+  buf_.reserve(4096);
+}
+
+Output::~Output()
+{
+}
+
+size_t Output::size() const
+{
+  return size_;
+}
+
+Output& Output::append(std::string const& str)
+{
+  return append(str.data(), str.size());
+}
+
+Output& Output::append(char const* data, size_t size)
+{
+  if (size == 0) return *this;
+
+  if (segs_.empty() || segs_.back().data != nullptr)
+  {
+    Segment seg;
+    seg.off = buf_.size();
+    segs_.emplace_back(seg);
+  }
+
+  buf_.append(data, size);
+  segs_.back().size += size;
+  size_ += size;
+
+  return *this;
+}
+
+Output& Output::append(char c)
+{
+  return append(&c, 1);
+}
+
+Output& Output::append(size_t num)
+{
+  char str[AEC::uint_max];
+  return append(str, static_cast<size_t>(AEC::decimal(str, num) - str));
+}
+
+Output& Output::append(AEC::Seq const& seq)
+{
+  return append(seq.data, seq.size);
+}
+
+Output& Output::attach(char const* data, size_t size)
+{
+  if (size == 0) return *this;
+
+  // bytes that carry on from the last ones referenced extend them
+  if (! segs_.empty() && segs_.back().data != nullptr && segs_.back().data + segs_.back().size == data)
+  {
+    segs_.back().size += size;
+    size_ += size;
+    return *this;
+  }
+
+  // past what one writev takes the bytes are copied instead,
+  // so that a frame still goes out in a single call
+  if (segs_.size() + 1 >= iov_max)
+  {
+    return append(data, size);
+  }
+
+  Segment seg;
+  seg.data = data;
+  seg.size = size;
+  segs_.emplace_back(seg);
+  size_ += size;
+
+  return *this;
+}
+
+Output& Output::attach(Output const& other)
+{
+  for (auto const& e : other.segs_)
+  {
+    attach(e.data ? e.data : other.buf_.data() + e.off, e.size);
+  }
+
+  return *this;
+}
+
+Output& Output::cursor_set(size_t x, size_t y)
+{
+  char str[AEC::cursor_set_max];
+  return append(str, static_cast<size_t>(AEC::cursor_set(str, x, y) - str));
+}
+
+size_t Output::flush()
+{
+  size_t const total {size_};
+  if (total == 0)
+  {
+    clear();
+    return 0;
+  }
+
+  // the staging buffer may have moved while it grew,
+  // so the pointers are only resolved here
+  struct iovec iov[iov_max];
+
+  size_t cnt {0};
+  for (auto const& e : segs_)
+  {
+    iov[cnt].iov_base = const_cast<char*>(e.data ? e.data : buf_.data() + e.off);
+    iov[cnt].iov_len = e.size;
+    if (++cnt == iov_max)
+    {
+      sink_->write(iov, cnt);
+      cnt = 0;
+    }
+  }
+  if (cnt > 0)
+  {
+    sink_->write(iov, cnt);
+  }
+  sink_->end();
+
+  clear();
+
+  return total;
+}
+
+void Output::clear()
+{
+  buf_.clear();
+  segs_.clear();
+  size_ = 0;
+}
+
+} // namespace OB
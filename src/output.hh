@@ -0,0 +1,189 @@
+#ifndef OB_OUTPUT_HH
+#define OB_OUTPUT_HH
+
+#include "ansi_escape_codes.hh"
+
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstddef>
+
+namespace OB
+{
+
+// where the bytes of an output end up
+class Sink
+{
+public:
+  virtual ~Sink() {}
+
+  // take every byte of the segments, the iovecs may be modified
+  virtual void write(struct iovec* iov, size_t cnt) = 0;
+
+  // everything written since the last call makes up a frame
+  virtual void end() {}
+
+  // whether a reader has to be sent a whole frame, rather than the changes
+  virtual bool behind() { return false; }
+
+}; // class Sink
+
+// a file descriptor, written with writev
+class Fd_Sink : public Sink
+{
+public:
+  // the descriptor is not closed
+  explicit Fd_Sink(int fd = STDOUT_FILENO);
+
+  // the file is created or truncated, and closed with the sink
+  explicit Fd_Sink(std::string const& file_name);
+
+  Fd_Sink(Fd_Sink const&) = delete;
+  Fd_Sink& operator=(Fd_Sink const&) = delete;
+  ~Fd_Sink();
+
+  int fd() const;
+  void write(struct iovec* iov, size_t cnt) override;
+
+private:
+  int fd_ {STDOUT_FILENO};
+  bool owned_ {false};
+
+}; // class Fd_Sink
+
+// a terminal written without blocking, what it does not take at once
+// is kept and written as it drains, how much is still on its way
+// and the rate the terminal takes it at tell when it has fallen behind
+class Tty_Sink : public Sink
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // the terminal is opened again, so that the nonblocking mode
+  // is not shared with stdin, a descriptor that is no terminal
+  // is written as it is, and waited on up to the deadline
+  explicit Tty_Sink(int fd = STDOUT_FILENO);
+
+  Tty_Sink(Tty_Sink const&) = delete;
+  Tty_Sink& operator=(Tty_Sink const&) = delete;
+
+  // waits a moment for whatever is still pending, then drops it
+  ~Tty_Sink();
+
+  int fd() const;
+  void write(struct iovec* iov, size_t cnt) override;
+
+  // how long a write to a descriptor that is no terminal may wait,
+  // what it has not taken by then is kept pending, no limit by default
+  void set_deadline(Clock::time_point tp);
+
+  // write what is pending without blocking, true once nothing is
+  bool drain();
+  bool pending() const;
+
+  // bytes written that the terminal has not taken yet, those kept here
+  // and those in the output queue of the terminal driver,
+  // the rate is measured from how fast they go while there are any
+  size_t queued();
+
+  // whether what is queued can not be taken by the time point
+  bool late(Clock::time_point tp);
+
+  // measure the rate by writing cursor moves that leave the screen as it is,
+  // in growing bursts for at most the given time, skipped for a pty
+  // or any terminal whose driver queue can not be seen
+  void probe(Clock::duration limit);
+
+private:
+  int fd_ {STDOUT_FILENO};
+  bool owned_ {false};
+
+  // TIOCOUTQ shows what the driver holds, it reads 0 on a pty
+  bool visible_ {false};
+  std::string pending_;
+
+  // bytes the driver took, and how many of those had left its queue when last seen
+  size_t sent_ {0};
+  size_t taken_ {0};
+  Clock::time_point seen_;
+  bool busy_ {false};
+
+  // bytes per second, 0 until measured
+  double rate_ {0};
+
+  Clock::time_point deadline_ {Clock::time_point::max()};
+
+  // write what is pending as the descriptor takes it, until the time point,
+  // true once nothing is, false as well once it fails
+  bool wait(Clock::time_point tp);
+  size_t put(struct iovec const* iov, size_t cnt);
+  size_t outq() const;
+
+}; // class Tty_Sink
+
+// collects everything that makes up a frame and writes it out
+// with as few writev calls on the raw file descriptor as possible,
+// the staging buffer is reused between frames
+class Output
+{
+public:
+  explicit Output(int fd = STDOUT_FILENO);
+
+  // the sink must outlive the output
+  explicit Output(Sink& sink);
+
+  Output(Output const&) = delete;
+  Output& operator=(Output const&) = delete;
+  ~Output();
+
+  // number of bytes waiting to be flushed
+  size_t size() const;
+
+  // copy bytes into the staging buffer
+  Output& append(std::string const& str);
+  Output& append(char const* data, size_t size);
+  Output& append(char c);
+  Output& append(size_t num);
+  Output& append(ANSI_Escape_Codes::Seq const& seq);
+
+  // reference bytes without copying them,
+  // they must stay valid until the next flush,
+  // once a frame has as many segments as one writev takes they are copied
+  Output& attach(char const* data, size_t size);
+
+  // reference everything queued in another output without copying it,
+  // it must not change until the next flush
+  Output& attach(Output const& other);
+
+  // cursor position escape sequence, 1 based
+  Output& cursor_set(size_t x, size_t y);
+
+  // write out everything queued, returns the number of bytes written
+  size_t flush();
+
+  // drop everything queued without writing it
+  void clear();
+
+private:
+  struct Segment
+  {
+    // nullptr refers to the staging buffer
+    char const* data {nullptr};
+    size_t off {0};
+    size_t size {0};
+  }; // struct Segment
+
+  Fd_Sink fd_;
+  Sink* sink_ {nullptr};
+  std::string buf_;
+  std::vector<Segment> segs_;
+  size_t size_ {0};
+
+}; // class Output
+
+} // namespace OB
+
+#endif // OB_OUTPUT_HH
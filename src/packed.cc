@@ -0,0 +1,301 @@
+#include "packed.hh"
+#include "source.hh"
+#include "plan.hh"
+#include "stats.hh"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace OB
+{
+
+namespace
+{
+
+  // equal bytes shorter than this are cheaper to store than to skip
+  size_t const min_copy {4};
+
+  // the intervals tried, doubling from the shortest
+  size_t const min_interval {8};
+  size_t const max_interval {1024};
+
+  // numbers are stored 7 bits to a byte, low bits first
+  void varint(std::string& out, size_t num)
+  {
+    while (num >= 0x80)
+    {
+      out += static_cast<char>((num & 0x7f) | 0x80);
+      num >>= 7;
+    }
+    out += static_cast<char>(num);
+  }
+
+  size_t varint(char const*& pos)
+  {
+    size_t num {0};
+    for (size_t shift = 0;; shift += 7)
+    {
+      auto const c = static_cast<unsigned char>(*pos++);
+      num |= static_cast<size_t>(c & 0x7f) << shift;
+      if (c < 0x80) return num;
+    }
+  }
+
+} // namespace
+
+size_t const Packed::npos {std::numeric_limits<size_t>::max()};
+
+Packed::Packed(Plan const& plan, size_t budget, size_t window) :
+  window_ {window}
+{
+  size_t const count {plan.size()};
+  frames_.assign(plan.frames(), plan.frames() + count);
+  regions_.assign(plan.regions(), plan.regions() + plan.region_count());
+
+  // the size of every frame packed whole and packed against the one before it
+  std::vector<size_t> whole (count);
+  std::vector<size_t> delta (count);
+  size_t largest {0};
+  {
+    std::string buf;
+    View prev;
+    for (size_t i = 0; i < count; ++i)
+    {
+      View const v {plan.at(i)};
+      buf.clear();
+      pack(v, nullptr, buf);
+      whole[i] = buf.size();
+      buf.clear();
+      pack(v, i > 0 ? &prev : nullptr, buf);
+      delta[i] = buf.size();
+      largest = std::max(largest, v.size + v.height * sizeof(size_t));
+      prev = v;
+    }
+  }
+
+  // the shortest interval that fits, each unpacked frame takes about as much as the largest
+  size_t const tables {frames_.size() * sizeof(Frame) + regions_.size() * sizeof(Region)};
+  size_t const unpacked {(window_ + 6) * largest};
+  for (interval_ = min_interval;; interval_ *= 2)
+  {
+    size_t total {tables + unpacked};
+    for (size_t i = 0; i < count; ++i)
+    {
+      total += i % interval_ == 0 ? whole[i] : delta[i];
+    }
+    if (total <= budget || interval_ >= max_interval) break;
+  }
+
+  View prev;
+  for (size_t i = 0; i < count; ++i)
+  {
+    View const v {plan.at(i)};
+    frames_[i].off = data_.size();
+    pack(v, i % interval_ != 0 ? &prev : nullptr, data_);
+    prev = v;
+  }
+  data_.shrink_to_fit();
+
+  slots_.resize(window_ + 4);
+
+  packing_.bytes = plan.bytes();
+  packing_.packed = data_.size() + tables;
+  packing_.interval = interval_;
+  packing_.window = window_;
+}
+
+Packed::~Packed()
+{
+}
+
+size_t Packed::size() const
+{
+  return frames_.size();
+}
+
+bool Packed::view(size_t i, View& v)
+{
+  if (i >= frames_.size()) return false;
+
+  if (find(i) == nullptr) ++packing_.misses;
+  auto const& slot = get(i);
+  shown_[0] = shown_[1];
+  shown_[1] = i;
+  back_ = shown_[0] == (i + 1) % frames_.size();
+
+  auto const& f = frames_[i];
+  v = View();
+  v.data = slot.data.data();
+  v.size = slot.data.size();
+  v.height = f.height;
+  v.width = f.width;
+  v.lines = slot.lines.data();
+  v.regions = regions_.data() + f.region;
+  v.region_count = f.region_count;
+  v.delay = f.delay;
+  return true;
+}
+
+bool Packed::seekable(size_t i) const
+{
+  return i < frames_.size();
+}
+
+void Packed::prefetch()
+{
+  if (frames_.empty() || shown_[1] == npos) return;
+  size_t const n {frames_.size()};
+  for (size_t k = 1; k <= window_; ++k)
+  {
+    get(back_ ? (shown_[1] + n - k % n) % n : (shown_[1] + k) % n);
+  }
+}
+
+Packing const& Packed::packing() const
+{
+  return packing_;
+}
+
+void Packed::pack(View const& v, View const* prev, std::string& out)
+{
+  // each line is its length followed by runs of bytes equal to the line above
+  // in the frame before, and runs of bytes stored as they are, in turn
+  for (size_t r = 0; r < v.height; ++r)
+  {
+    size_t len {0};
+    char const* const q {v.line(r, len)};
+    size_t plen {0};
+    char const* const p {prev && r < prev->height ? prev->line(r, plen) : nullptr};
+    size_t const common {std::min(len, plen)};
+
+    varint(out, len);
+    size_t col {0};
+    while (col < len)
+    {
+      size_t copy {0};
+      while (col + copy < common && q[col + copy] == p[col + copy]) ++copy;
+      varint(out, copy);
+      col += copy;
+      if (col == len) break;
+
+      size_t lit {0};
+      while (col + lit < len &&
+        ! (col + lit + min_copy <= common && std::memcmp(q + col + lit, p + col + lit, min_copy) == 0))
+      {
+        ++lit;
+      }
+      varint(out, lit);
+      out.append(q + col, lit);
+      col += lit;
+    }
+  }
+}
+
+void Packed::unpack(size_t i, Slot const* prev, Slot& dst)
+{
+  auto const start = std::chrono::steady_clock::now();
+
+  auto const& f = frames_[i];
+  dst.frame = i;
+  dst.data.resize(f.size);
+  dst.lines.clear();
+
+  char const* pos {data_.data() + f.off};
+  char* out {&dst.data[0]};
+  for (size_t r = 0; r < f.height; ++r)
+  {
+    if (r > 0) *out++ = '\n';
+    dst.lines.emplace_back(static_cast<size_t>(out - dst.data.data()));
+
+    char const* p {nullptr};
+    if (prev && r < prev->lines.size()) p = prev->data.data() + prev->lines[r];
+
+    size_t const len {varint(pos)};
+    size_t col {0};
+    while (col < len)
+    {
+      size_t const copy {varint(pos)};
+      if (copy > 0) std::memcpy(out, p + col, copy);
+      out += copy;
+      col += copy;
+      if (col == len) break;
+
+      size_t const lit {varint(pos)};
+      std::memcpy(out, pos, lit);
+      pos += lit;
+      out += lit;
+      col += lit;
+    }
+  }
+
+  packing_.unpack.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count()));
+}
+
+Packed::Slot* Packed::find(size_t i)
+{
+  for (auto& e : slots_)
+  {
+    if (e.frame == i) return &e;
+  }
+  return nullptr;
+}
+
+Packed::Slot& Packed::get(size_t i)
+{
+  if (auto const slot = find(i)) return *slot;
+
+  // a frame after a whole one is unpacked from the one before it,
+  // which unless it is at hand is unpacked from the whole frame first
+  Slot const* prev {nullptr};
+  if (i % interval_ != 0)
+  {
+    prev = find(i - 1);
+    if (prev == nullptr)
+    {
+      size_t const key {i - i % interval_};
+      unpack(key, nullptr, scratch_[0]);
+      for (size_t j = key + 1; j < i; ++j)
+      {
+        unpack(j, &scratch_[(j - key - 1) % 2], scratch_[(j - key) % 2]);
+      }
+      prev = &scratch_[(i - 1 - key) % 2];
+    }
+  }
+
+  auto& dst = victim(prev);
+  unpack(i, prev, dst);
+  return dst;
+}
+
+Packed::Slot& Packed::victim(Slot const* keep)
+{
+  // the frames on screen and the one unpacked from stay,
+  // an empty slot or one behind playback goes first
+  Slot* res {nullptr};
+  for (auto& e : slots_)
+  {
+    if (&e == keep) continue;
+    if (e.frame == npos) return e;
+    if (e.frame == shown_[0] || e.frame == shown_[1]) continue;
+
+    size_t const n {frames_.size()};
+    bool const ahead {shown_[1] != npos &&
+      (back_ ? shown_[1] + n - e.frame : e.frame + n - shown_[1]) % n <= window_};
+    if (res == nullptr || ! ahead) res = &e;
+    if (! ahead) break;
+  }
+
+  // there is always a slot besides the frames on screen and the one unpacked from
+  assert(res != nullptr);
+  return *res;
+}
+
+} // namespace OB
@@ -0,0 +1,80 @@
+#ifndef OB_PACKED_HH
+#define OB_PACKED_HH
+
+#include "source.hh"
+#include "plan.hh"
+#include "stats.hh"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace OB
+{
+
+// the frames of a plan kept delta compressed in memory, every line is stored
+// as the bytes that differ from the same line of the frame before it,
+// with a whole frame every interval frames to start unpacking from,
+// a small window of frames is unpacked just ahead of playback
+class Packed : public Source
+{
+public:
+  // the interval is the shortest that fits the frames and the window in budget bytes,
+  // window is the number of frames unpacked ahead
+  Packed(Plan const& plan, size_t budget, size_t window);
+  Packed(Packed const&) = delete;
+  Packed& operator=(Packed const&) = delete;
+  ~Packed();
+
+  size_t size() const override;
+  bool view(size_t i, View& v) override;
+
+  // any frame, at the cost of unpacking it from the last whole frame before it
+  bool seekable(size_t i) const override;
+
+  // unpack the window after the last frame handed out,
+  // or before it while playing backwards
+  void prefetch() override;
+
+  Packing const& packing() const;
+
+private:
+  static size_t const npos;
+
+  struct Slot
+  {
+    size_t frame {npos};
+    std::string data;
+    std::vector<size_t> lines;
+  }; // struct Slot
+
+  // geometry of each frame as in the plan, off is where its packed bytes start
+  std::vector<Frame> frames_;
+  std::vector<Region> regions_;
+  std::string data_;
+  size_t interval_ {1};
+
+  // the window ahead of the last two frames handed out, those two,
+  // the one the next is unpacked from and a spare,
+  // frames between a whole frame and the one asked for are unpacked into scratch
+  std::vector<Slot> slots_;
+  Slot scratch_[2];
+  size_t shown_[2] {npos, npos};
+
+  // playback is going backwards, the window is unpacked behind it
+  bool back_ {false};
+  size_t window_ {0};
+
+  Packing packing_;
+
+  static void pack(View const& v, View const* prev, std::string& out);
+  void unpack(size_t i, Slot const* prev, Slot& dst);
+  Slot* find(size_t i);
+  Slot& get(size_t i);
+  Slot& victim(Slot const* keep);
+
+}; // class Packed
+
+} // namespace OB
+
+#endif // OB_PACKED_HH
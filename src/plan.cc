@@ -0,0 +1,876 @@
+#include "plan.hh"
+#include "mmap.hh"
+#include "scan.hh"
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+namespace OB
+{
+
+// first occurrence of str in [first, last), or last if not found
+static char const* find(char const* first, char const* last, std::string const& str)
+{
+  if (str.empty()) return last;
+  while (static_cast<size_t>(last - first) >= str.size())
+  {
+    auto const ptr = static_cast<char const*>(std::memchr(first, str[0], static_cast<size_t>(last - first) - str.size() + 1));
+    if (ptr == nullptr) break;
+    if (std::memcmp(ptr, str.data(), str.size()) == 0) return ptr;
+    first = ptr + 1;
+  }
+  return last;
+}
+
+// inputs are only split automatically into chunks at least this large
+static size_t const min_chunk {4 * 1024 * 1024};
+
+// bytes scanned at a time while indexing, small enough to stay in cache
+static size_t const window {64 * 1024};
+
+// run fn(0) to fn(n - 1), each on its own thread
+static void parallel(size_t n, std::function<void(size_t)> const& fn)
+{
+  std::vector<std::thread> workers;
+  workers.reserve(n - 1);
+  for (size_t i = 1; i < n; ++i)
+  {
+    workers.emplace_back(fn, i);
+  }
+  fn(0);
+  for (auto& e : workers)
+  {
+    e.join();
+  }
+}
+
+// hash of a run of bytes, a word at a time
+static uint64_t hash(char const* data, size_t size)
+{
+  uint64_t const mul {0xff51afd7ed558ccdull};
+  uint64_t h {0x9e3779b97f4a7c15ull ^ size};
+  size_t i {0};
+  for (; i + 8 <= size; i += 8)
+  {
+    uint64_t w;
+    std::memcpy(&w, data + i, 8);
+    h = (h ^ w) * mul;
+    h ^= h >> 32;
+  }
+  uint64_t w {0};
+  std::memcpy(&w, data + i, size - i);
+  h = (h ^ w) * mul;
+  return h ^ (h >> 29);
+}
+
+// whether the line at data, with size bytes left in the input,
+// starts with one of the keywords of a layered frame
+static bool directive(char const* data, size_t size)
+{
+  static char const* const keywords[] {"LAYER", "COLOR", "DELAY"};
+  size_t const len {5};
+  if (size < len || (data[0] != 'L' && data[0] != 'C' && data[0] != 'D')) return false;
+  if (size > len && data[len] != ' ' && data[len] != '\n') return false;
+  for (auto const e : keywords)
+  {
+    if (std::memcmp(data, e, len) == 0) return true;
+  }
+  return false;
+}
+
+// frames looked at to estimate whether interning pays off
+static size_t const sample_frames {8};
+
+// the share of the bytes of a sample of frames in rows seen before,
+// either in the frame itself or in the one before it,
+// repeats further apart are not seen so it only ever undercounts
+static double repeats(Plan const& plan)
+{
+  size_t const count {plan.size()};
+  size_t const step {std::max(count / sample_frames, static_cast<size_t>(1))};
+  uint64_t total {0};
+  uint64_t seen {0};
+
+  // hashes and lengths of the rows, sorted so that repeats sit next to each other
+  std::vector<uint64_t> prev;
+  std::vector<std::pair<uint64_t, size_t>> rows;
+  for (size_t i = 0; i < count; i += step)
+  {
+    prev.clear();
+    if (i > 0)
+    {
+      View const v {plan.at(i - 1)};
+      for (size_t r = 0; r < v.height; ++r)
+      {
+        size_t len {0};
+        char const* const line {v.line(r, len)};
+        prev.emplace_back(hash(line, len));
+      }
+      std::sort(prev.begin(), prev.end());
+    }
+
+    rows.clear();
+    View const v {plan.at(i)};
+    for (size_t r = 0; r < v.height; ++r)
+    {
+      size_t len {0};
+      char const* const line {v.line(r, len)};
+      rows.emplace_back(hash(line, len), len + 1);
+    }
+    std::sort(rows.begin(), rows.end());
+
+    for (size_t r = 0; r < rows.size(); ++r)
+    {
+      total += rows[r].second;
+      if ((r > 0 && rows[r - 1].first == rows[r].first) ||
+        std::binary_search(prev.begin(), prev.end(), rows[r].first))
+      {
+        seen += rows[r].second;
+      }
+    }
+  }
+  return total > 0 ? static_cast<double>(seen) / static_cast<double>(total) : 0.0;
+}
+
+namespace
+{
+
+// open addressing table of ids, the entries they stand for
+// are kept and compared by the caller
+class Ids
+{
+public:
+  // the id of an entry equal to the one with hash h, as told by eq,
+  // or if there is none, id, which is then added
+  template<class Eq>
+  size_t get(uint64_t h, size_t id, Eq const& eq)
+  {
+    // kept at most half full
+    if ((count_ + 1) * 2 > slots_.size()) grow();
+
+    size_t const mask {slots_.size() - 1};
+    for (size_t i = static_cast<size_t>(h) & mask;; i = (i + 1) & mask)
+    {
+      auto& e = slots_[i];
+      if (e.id == 0)
+      {
+        e.hash = h;
+        e.id = id + 1;
+        ++count_;
+        return id;
+      }
+      if (e.hash == h && eq(e.id - 1)) return e.id - 1;
+    }
+  }
+
+private:
+  struct Slot
+  {
+    uint64_t hash {0};
+
+    // the id + 1, 0 is empty
+    size_t id {0};
+  }; // struct Slot
+
+  std::vector<Slot> slots_;
+  size_t count_ {0};
+
+  void grow()
+  {
+    std::vector<Slot> slots (std::max(slots_.size() * 2, static_cast<size_t>(1024)));
+    size_t const mask {slots.size() - 1};
+    for (auto const& e : slots_)
+    {
+      if (e.id == 0) continue;
+      size_t i {static_cast<size_t>(e.hash) & mask};
+      while (slots[i].id != 0) i = (i + 1) & mask;
+      slots[i] = e;
+    }
+    slots_ = std::move(slots);
+  }
+
+}; // class Ids
+
+} // namespace
+
+Plan::Plan()
+{
+}
+
+Plan::Plan(std::vector<std::string> const& frames) :
+  Plan(frames, {})
+{
+}
+
+Plan::Plan(std::vector<std::string> const& frames, std::vector<std::vector<Region>> const& regions,
+  std::vector<size_t> const& delays)
+{
+  size_t total {0};
+  for (auto const& e : frames)
+  {
+    total += e.size();
+  }
+  buf_.reserve(total);
+  frames_.reserve(frames.size());
+
+  std::vector<size_t> offs;
+  offs.reserve(frames.size() + 1);
+  for (auto const& e : frames)
+  {
+    offs.emplace_back(buf_.size());
+    buf_.append(e);
+  }
+  offs.emplace_back(buf_.size());
+
+  base_ = buf_.data();
+  for (size_t i = 0; i < frames.size(); ++i)
+  {
+    add(offs.at(i), offs.at(i + 1) - offs.at(i));
+    if (i < regions.size())
+    {
+      frames_.back().region = regions_.size();
+      frames_.back().region_count = regions[i].size();
+      regions_.insert(regions_.end(), regions[i].begin(), regions[i].end());
+    }
+    if (i < delays.size())
+    {
+      frames_.back().delay = delays[i];
+    }
+  }
+  bind();
+}
+
+Plan::Plan(Mmap&& map, size_t offset, std::string const& delim, size_t threads) :
+  map_ {std::move(map)}
+{
+  base_ = map_.data();
+  if (offset > map_.size()) offset = map_.size();
+
+  size_t const size {map_.size() - offset};
+  if (threads == 0)
+  {
+    threads = std::min(static_cast<size_t>(std::max(std::thread::hardware_concurrency(), 1u)), size / min_chunk);
+  }
+  threads = std::min(threads, size);
+
+  // a delimiter that ends the only line it is on can only match at a newline,
+  // so frames and lines are found in one sweep over the newlines
+  if (! delim.empty() && delim.find('\n') == delim.size() - 1)
+  {
+    index(offset, delim, std::max(threads, static_cast<size_t>(1)));
+    bind();
+    return;
+  }
+
+  if (threads > 1 && ! delim.empty())
+  {
+    split(offset, delim, threads);
+    bind();
+    return;
+  }
+
+  // same splitting rules as delimiting the content string,
+  // the frame after the last delimiter is always present
+  char const* const last {base_ + map_.size()};
+  char const* start {base_ + offset};
+  for (;;)
+  {
+    char const* const end {find(start, last, delim)};
+    add(static_cast<size_t>(start - base_), static_cast<size_t>(end - start));
+    if (end == last) break;
+    start = end + delim.size();
+  }
+  bind();
+}
+
+Plan::Plan(Mmap&& map, size_t data_off, size_t frames_off, size_t count, size_t lines_off, size_t line_count,
+  size_t regions_off, size_t region_count) :
+  map_ {std::move(map)},
+  mapped_ {true},
+  base_off_ {data_off},
+  frames_off_ {frames_off},
+  lines_off_ {lines_off},
+  regions_off_ {regions_off},
+  count_ {count},
+  line_count_ {line_count},
+  region_count_ {region_count}
+{
+  bind();
+}
+
+Plan Plan::intern(Plan&& plan)
+{
+  Dedup d;
+  d.frames = plan.size();
+
+  // a pass over every row costs several times the load,
+  // it is only made when a sample of the rows repeats enough to be worth it
+  d.estimate = repeats(plan);
+  if (d.estimate < 0.125)
+  {
+    d.skipped = true;
+    d.rows = plan.line_count();
+    d.bytes = plan.bytes();
+    d.stored = d.bytes;
+    plan.dedup_ = d;
+    return std::move(plan);
+  }
+
+  // every line gets the id of the first row equal to it,
+  // rows are still read from where they were found
+  std::vector<Row> found;
+  std::vector<size_t> ids;
+  std::vector<size_t> start (plan.size());
+  ids.reserve(plan.line_count());
+  uint64_t unique_bytes {0};
+  Ids rows;
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    View const v {plan.at(i)};
+    d.bytes += v.size;
+    start[i] = ids.size();
+    for (size_t r = 0; r < v.height; ++r)
+    {
+      size_t len {0};
+      char const* const line {v.line(r, len)};
+      size_t const off {static_cast<size_t>(line - plan.base())};
+      size_t const id {rows.get(hash(line, len), found.size(), [&](size_t k)
+      {
+        return found[k].len == len && std::memcmp(plan.base() + found[k].off, line, len) == 0;
+      })};
+      if (id == found.size())
+      {
+        found.emplace_back(Row {off, len});
+        unique_bytes += len + 1;
+      }
+      ids.emplace_back(id);
+    }
+  }
+  d.rows = ids.size();
+  d.unique_rows = found.size();
+
+  // a frame is its list of ids, frames with the same list share one
+  std::vector<size_t> first (plan.size());
+  size_t kept {0};
+  Ids frames;
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    size_t const height {plan.frames()[i].height};
+    size_t const* const list {ids.data() + start[i]};
+    first[i] = frames.get(hash(reinterpret_cast<char const*>(list), height * sizeof(size_t)), i, [&](size_t k)
+    {
+      return plan.frames()[k].height == height && std::equal(list, list + height, ids.data() + start[k]);
+    });
+    if (first[i] == i)
+    {
+      ++d.unique_frames;
+      kept += height;
+    }
+  }
+
+  d.bytes += plan.line_count() * sizeof(size_t);
+  d.stored = unique_bytes + found.size() * sizeof(Row) + kept * sizeof(size_t);
+  d.interned = d.stored * 4 <= d.bytes * 3;
+  if (! d.interned)
+  {
+    plan.dedup_ = d;
+    return std::move(plan);
+  }
+
+  Plan res;
+  res.dedup_ = d;
+  res.directives_ = plan.directives_;
+
+  // rows in the order they were first seen, so that a frame
+  // made of new rows is still one run of bytes
+  res.buf_.reserve(unique_bytes);
+  res.rows_.reserve(found.size());
+  for (auto const& e : found)
+  {
+    res.rows_.emplace_back(Row {res.buf_.size(), e.len});
+    res.buf_.append(plan.base() + e.off, e.len);
+    res.buf_ += '\n';
+  }
+
+  res.lines_.reserve(kept);
+  res.frames_.reserve(plan.size());
+  for (size_t i = 0; i < plan.size(); ++i)
+  {
+    Frame f {plan.frames()[i]};
+    f.off = 0;
+    if (first[i] == i)
+    {
+      size_t const* const list {ids.data() + start[i]};
+      f.line = res.lines_.size();
+      res.lines_.insert(res.lines_.end(), list, list + f.height);
+    }
+    else
+    {
+      f.line = res.frames_[first[i]].line;
+    }
+    res.frames_.emplace_back(f);
+  }
+  res.regions_.assign(plan.regions(), plan.regions() + plan.region_count());
+  res.bind();
+
+  return res;
+}
+
+Plan::Plan(Plan&& other)
+{
+  *this = std::move(other);
+}
+
+Plan& Plan::operator=(Plan&& other)
+{
+  if (this != &other)
+  {
+    map_ = std::move(other.map_);
+
+    // moving a short string copies it and keeps the buffer it replaces
+    std::string().swap(buf_);
+    buf_ = std::move(other.buf_);
+    frames_ = std::move(other.frames_);
+    lines_ = std::move(other.lines_);
+    regions_ = std::move(other.regions_);
+    rows_ = std::move(other.rows_);
+    dedup_ = other.dedup_;
+    directives_ = other.directives_;
+    mapped_ = other.mapped_;
+    base_off_ = other.base_off_;
+    frames_off_ = other.frames_off_;
+    lines_off_ = other.lines_off_;
+    regions_off_ = other.regions_off_;
+    count_ = other.count_;
+    line_count_ = other.line_count_;
+    region_count_ = other.region_count_;
+
+    // a moved string may not keep its address
+    bind();
+    other.bind();
+  }
+  return *this;
+}
+
+Plan::~Plan()
+{
+}
+
+size_t Plan::size() const
+{
+  return count_;
+}
+
+bool Plan::view(size_t i, View& v)
+{
+  if (i >= count_) return false;
+  v = at(i);
+  return true;
+}
+
+bool Plan::seekable(size_t i) const
+{
+  return i < count_;
+}
+
+bool Plan::stable() const
+{
+  return true;
+}
+
+bool Plan::empty() const
+{
+  return count_ == 0;
+}
+
+View Plan::at(size_t i) const
+{
+  if (i >= count_)
+  {
+    throw std::out_of_range("frame index out of range");
+  }
+  auto const& f = table_[i];
+  View v;
+  v.data = base_ + f.off;
+  v.size = f.size;
+  v.height = f.height;
+  v.width = f.width;
+  v.lines = line_table_ + f.line;
+  v.rows = row_table_;
+  v.regions = region_table_ + f.region;
+  v.region_count = f.region_count;
+  v.delay = f.delay;
+  return v;
+}
+
+char const* Plan::base() const
+{
+  return base_;
+}
+
+Frame const* Plan::frames() const
+{
+  return table_;
+}
+
+size_t const* Plan::lines() const
+{
+  return line_table_;
+}
+
+size_t Plan::line_count() const
+{
+  return line_count_;
+}
+
+Region const* Plan::regions() const
+{
+  return region_table_;
+}
+
+size_t Plan::region_count() const
+{
+  return region_count_;
+}
+
+Row const* Plan::rows() const
+{
+  return row_table_;
+}
+
+Dedup const& Plan::dedup() const
+{
+  return dedup_;
+}
+
+bool Plan::directives() const
+{
+  return directives_;
+}
+
+size_t Plan::bytes() const
+{
+  size_t res {line_count_ * sizeof(size_t)};
+  if (row_table_)
+  {
+    return res + buf_.size() + rows_.size() * sizeof(Row);
+  }
+  for (size_t i = 0; i < count_; ++i)
+  {
+    res += table_[i].size;
+  }
+  return res;
+}
+
+void Plan::measure(char const* data, size_t& size, size_t& height, size_t& width, std::vector<size_t>& lines)
+{
+  height = 0;
+  width = 0;
+
+  // the cursor stays on the last line of the frame,
+  // so the trailing newline is not part of the output
+  if (size > 0 && data[size - 1] == '\n')
+  {
+    --size;
+  }
+
+  if (size == 0) return;
+
+  // the newlines are turned into the start of the line after them
+  size_t const first {lines.size()};
+  lines.emplace_back(0);
+  Scan::newlines(data, data + size, lines);
+  height = lines.size() - first;
+  for (size_t i = first + 1; i < lines.size(); ++i)
+  {
+    size_t const len {lines[i] - lines[i - 1]};
+    if (len > width) width = len;
+    ++lines[i];
+  }
+  if (size - lines.back() > width) width = size - lines.back();
+}
+
+void Plan::add(size_t off, size_t size)
+{
+  Frame f;
+  f.off = off;
+  f.size = size;
+  f.line = lines_.size();
+  measure(base_ + off, f.size, f.height, f.width, lines_);
+  scan_directives(base_ + off, lines_.data() + f.line, f.height, f.size);
+  frames_.emplace_back(f);
+}
+
+void Plan::scan_directives(char const* data, size_t const* lines, size_t count, size_t size)
+{
+  for (size_t i = 0; i < count && ! directives_; ++i)
+  {
+    directives_ = directive(data + lines[i], size - lines[i]);
+  }
+}
+
+void Plan::split(size_t offset, std::string const& delim, size_t threads)
+{
+  char const* const first {base_ + offset};
+  char const* const last {base_ + map_.size()};
+  size_t const chunk {(static_cast<size_t>(last - first) + threads - 1) / threads};
+
+  // every match that starts inside a chunk, reading past its end as needed,
+  // overlapping matches are kept so that the merge can pick the same ones
+  // as a serial scan
+  std::vector<std::vector<size_t>> found (threads);
+  parallel(threads, [&](size_t k)
+  {
+    char const* const begin {first + std::min(k * chunk, static_cast<size_t>(last - first))};
+    char const* const end {begin + std::min(chunk, static_cast<size_t>(last - begin))};
+    char const* const stop {end + std::min(delim.size() - 1, static_cast<size_t>(last - end))};
+    for (char const* pos = begin;;)
+    {
+      char const* const match {find(pos, stop, delim)};
+      if (match == stop) break;
+      found[k].emplace_back(static_cast<size_t>(match - base_));
+      pos = match + 1;
+    }
+  });
+
+  // leftmost non-overlapping matches, in order, as found by the serial scan
+  std::vector<Frame> spans;
+  size_t start {offset};
+  for (auto const& e : found)
+  {
+    for (auto const pos : e)
+    {
+      if (pos < start) continue;
+      Frame f;
+      f.off = start;
+      f.size = pos - start;
+      spans.emplace_back(f);
+      start = pos + delim.size();
+    }
+  }
+  Frame tail;
+  tail.off = start;
+  tail.size = map_.size() - start;
+  spans.emplace_back(tail);
+
+  // frames are measured in groups of about a chunk of bytes each,
+  // then the line tables are joined in order
+  std::vector<size_t> group (threads + 1, spans.size());
+  for (size_t k = 0; k < threads; ++k)
+  {
+    size_t const off {offset + k * chunk};
+    group[k] = static_cast<size_t>(std::lower_bound(spans.begin(), spans.end(), off,
+      [](Frame const& f, size_t o) { return f.off < o; }) - spans.begin());
+  }
+  group[0] = 0;
+
+  std::vector<std::vector<size_t>> lines (threads);
+  parallel(threads, [&](size_t k)
+  {
+    for (size_t i = group[k]; i < group[k + 1]; ++i)
+    {
+      auto& f = spans[i];
+      f.line = lines[k].size();
+      measure(base_ + f.off, f.size, f.height, f.width, lines[k]);
+    }
+  });
+
+  size_t total {0};
+  for (auto const& e : lines)
+  {
+    total += e.size();
+  }
+  lines_.reserve(total);
+  for (size_t k = 0; k < threads; ++k)
+  {
+    for (size_t i = group[k]; i < group[k + 1]; ++i)
+    {
+      spans[i].line += lines_.size();
+    }
+    lines_.insert(lines_.end(), lines[k].begin(), lines[k].end());
+  }
+  frames_ = std::move(spans);
+
+  for (auto const& e : frames_)
+  {
+    scan_directives(base_ + e.off, lines_.data() + e.line, e.height, e.size);
+  }
+}
+
+void Plan::index(size_t offset, std::string const& delim, size_t threads)
+{
+  char const* const first {base_ + offset};
+  size_t const size {map_.size() - offset};
+  size_t const chunk {(size + threads - 1) / threads};
+  size_t const len {delim.size()};
+
+  // what a worker found in its chunk, positions are relative to first,
+  // the frames around the chunk edges are completed by the merge
+  struct Part
+  {
+    // newlines before the first delimiter, the rest of the frame left open by the chunk before
+    std::vector<size_t> head;
+    bool delim {false};
+    size_t head_end {0};
+
+    // frames between the first and the last delimiter, with their own line table,
+    // the first chunk adds its frames to the plan directly
+    std::vector<Frame> frames;
+    std::vector<size_t> lines;
+
+    // the frame after the last delimiter, left open for the next chunk
+    size_t tail {0};
+    std::vector<size_t> breaks;
+
+    // a line after one of the newlines starts with a keyword of a layered frame
+    bool directives {false};
+  }; // struct Part
+
+  // the delimiter can not span lines, so it matches wherever it ends at a newline,
+  // each newline is classified and added to its frame while its window is still in cache
+  std::vector<Part> parts (threads);
+  parallel(threads, [&](size_t k)
+  {
+    auto& part = parts[k];
+    auto& frames = k == 0 ? frames_ : part.frames;
+    auto& lines = k == 0 ? lines_ : part.lines;
+    size_t const begin {std::min(k * chunk, size)};
+    size_t const end {std::min(begin + chunk, size)};
+    std::vector<size_t> found;
+    part.delim = k == 0;
+    part.tail = begin;
+    for (size_t pos = begin; pos < end; pos += window)
+    {
+      size_t const stop {std::min(pos + window, end)};
+      found.clear();
+      Scan::newlines(first + pos, first + stop, found);
+      for (auto e : found)
+      {
+        e += pos;
+        if (! part.directives && directive(first + e + 1, size - e - 1))
+        {
+          part.directives = true;
+        }
+
+        if (e + 1 < len || std::memcmp(first + e + 1 - len, delim.data(), len - 1) != 0)
+        {
+          part.breaks.emplace_back(e);
+          continue;
+        }
+
+        if (part.delim)
+        {
+          frames.emplace_back(close(offset, part.tail, e + 1 - len, part.breaks, lines));
+        }
+        else
+        {
+          part.delim = true;
+          part.head_end = e + 1 - len;
+          part.head.swap(part.breaks);
+        }
+        part.breaks.clear();
+        part.tail = e + 1;
+      }
+    }
+  });
+
+  // the first line has no newline before it
+  directives_ = directive(first, size);
+  for (auto const& e : parts)
+  {
+    directives_ = directives_ || e.directives;
+  }
+
+  // join the parts in order, carrying the open frame across chunks
+  size_t start {parts[0].tail};
+  std::vector<size_t> breaks;
+  breaks.swap(parts[0].breaks);
+  for (size_t k = 1; k < threads; ++k)
+  {
+    auto& part = parts[k];
+    if (! part.delim)
+    {
+      breaks.insert(breaks.end(), part.breaks.begin(), part.breaks.end());
+      continue;
+    }
+
+    breaks.insert(breaks.end(), part.head.begin(), part.head.end());
+    frames_.emplace_back(close(offset, start, part.head_end, breaks, lines_));
+
+    size_t const base {lines_.size()};
+    for (auto& e : part.frames)
+    {
+      e.line += base;
+      frames_.emplace_back(e);
+    }
+    lines_.insert(lines_.end(), part.lines.begin(), part.lines.end());
+
+    start = part.tail;
+    breaks.swap(part.breaks);
+  }
+  frames_.emplace_back(close(offset, start, size, breaks, lines_));
+}
+
+Frame Plan::close(size_t offset, size_t start, size_t end, std::vector<size_t>& breaks, std::vector<size_t>& lines)
+{
+  Frame f;
+  f.off = offset + start;
+  f.size = end - start;
+  f.line = lines.size();
+
+  // same as measure, the trailing newline is not part of the output
+  if (! breaks.empty() && breaks.back() == end - 1)
+  {
+    --f.size;
+    breaks.pop_back();
+  }
+
+  if (f.size > 0)
+  {
+    size_t line {start};
+    for (auto const e : breaks)
+    {
+      lines.emplace_back(line - start);
+      f.width = std::max(f.width, e - line);
+      line = e + 1;
+    }
+    lines.emplace_back(line - start);
+    f.width = std::max(f.width, start + f.size - line);
+    f.height = breaks.size() + 1;
+  }
+
+  breaks.clear();
+  return f;
+}
+
+void Plan::bind()
+{
+  if (mapped_)
+  {
+    base_ = map_.data() + base_off_;
+    table_ = reinterpret_cast<Frame const*>(map_.data() + frames_off_);
+    line_table_ = reinterpret_cast<size_t const*>(map_.data() + lines_off_);
+    region_table_ = reinterpret_cast<Region const*>(map_.data() + regions_off_);
+    row_table_ = nullptr;
+    return;
+  }
+
+  base_ = map_.data() ? map_.data() : buf_.data();
+  table_ = frames_.data();
+  count_ = frames_.size();
+  line_table_ = lines_.data();
+  line_count_ = lines_.size();
+  region_table_ = regions_.data();
+  region_count_ = regions_.size();
+  row_table_ = rows_.empty() ? nullptr : rows_.data();
+}
+
+} // namespace OB
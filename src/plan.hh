@@ -0,0 +1,150 @@
+#ifndef OB_PLAN_HH
+#define OB_PLAN_HH
+
+#include "mmap.hh"
+#include "source.hh"
+#include "color.hh"
+#include "stats.hh"
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace OB
+{
+
+// geometry and location of a single output-ready frame
+struct Frame
+{
+  // offset of the first byte from the start of the plan data
+  size_t off {0};
+
+  // number of bytes to write, the trailing newline is not included
+  size_t size {0};
+
+  // number of lines
+  size_t height {0};
+
+  // length of the longest line
+  size_t width {0};
+
+  // index of the first line in the plan line table,
+  // line offsets are relative to the start of the frame,
+  // in an interned plan the lines are indices into the row table
+  // and identical frames share them
+  size_t line {0};
+
+  // color regions in the plan region table
+  size_t region {0};
+  size_t region_count {0};
+
+  // time on screen in milliseconds, 0 for the default delay
+  size_t delay {0};
+}; // struct Frame
+
+// the render plan, built once at load time so that the playback loop
+// only has to write out contiguous, precomputed byte ranges
+class Plan : public Source
+{
+public:
+  Plan();
+
+  // frames are copied into a buffer owned by the plan
+  explicit Plan(std::vector<std::string> const& frames);
+
+  // the same, with the color regions and the delay of each frame
+  Plan(std::vector<std::string> const& frames, std::vector<std::vector<Region>> const& regions,
+    std::vector<size_t> const& delays = {});
+
+  // frames are indexed in place, starting at offset into the mapping,
+  // split across threads, 0 uses one per core once the input is large enough
+  Plan(Mmap&& map, size_t offset, std::string const& delim, size_t threads = 0);
+
+  // frame data, frame table, line table and region table are all in place in the mapping,
+  // as found in a compiled file
+  Plan(Mmap&& map, size_t data_off, size_t frames_off, size_t count, size_t lines_off, size_t line_count,
+    size_t regions_off, size_t region_count);
+
+  // repeated rows and frames are stored once, in a buffer owned by the plan,
+  // the plan is handed back as it is when that saves less than a quarter of its bytes,
+  // or without trying when a sample of its frames hardly repeats
+  static Plan intern(Plan&& plan);
+
+  Plan(Plan&& other);
+  Plan& operator=(Plan&& other);
+  ~Plan();
+
+  size_t size() const override;
+  bool view(size_t i, View& v) override;
+  bool seekable(size_t i) const override;
+  bool stable() const override;
+  bool empty() const;
+  View at(size_t i) const;
+
+  // the raw tables, frame offsets are relative to base
+  char const* base() const;
+  Frame const* frames() const;
+  size_t const* lines() const;
+  size_t line_count() const;
+  Region const* regions() const;
+  size_t region_count() const;
+
+  // the row table of an interned plan, nullptr otherwise
+  Row const* rows() const;
+
+  // what interning found, all zero when it was not tried
+  Dedup const& dedup() const;
+
+  // bytes of frame data and line tables the frames take up
+  size_t bytes() const;
+
+  // whether a line of a frame starts with a LAYER, COLOR or DELAY keyword,
+  // found while the frames are indexed
+  bool directives() const;
+
+  // find the output-ready size, line offsets and geometry of a frame,
+  // line offsets are appended to lines
+  static void measure(char const* data, size_t& size, size_t& height, size_t& width, std::vector<size_t>& lines);
+
+private:
+  Mmap map_;
+  std::string buf_;
+  std::vector<Frame> frames_;
+  std::vector<size_t> lines_;
+  std::vector<Region> regions_;
+  std::vector<Row> rows_;
+  Dedup dedup_;
+  bool directives_ {false};
+
+  // where the tables live inside the mapping, when they are not owned
+  bool mapped_ {false};
+  size_t base_off_ {0};
+  size_t frames_off_ {0};
+  size_t lines_off_ {0};
+  size_t regions_off_ {0};
+
+  // resolved by bind
+  char const* base_ {nullptr};
+  Frame const* table_ {nullptr};
+  size_t count_ {0};
+  size_t const* line_table_ {nullptr};
+  size_t line_count_ {0};
+  Region const* region_table_ {nullptr};
+  size_t region_count_ {0};
+  Row const* row_table_ {nullptr};
+
+  void add(size_t off, size_t size);
+  void scan_directives(char const* data, size_t const* lines, size_t count, size_t size);
+  void split(size_t offset, std::string const& delim, size_t threads);
+  void index(size_t offset, std::string const& delim, size_t threads);
+
+  // the frame in [start, end), relative to offset, split at the newlines in breaks,
+  // its line offsets are appended to lines and breaks is cleared
+  static Frame close(size_t offset, size_t start, size_t end, std::vector<size_t>& breaks, std::vector<size_t>& lines);
+  void bind();
+
+}; // class Plan
+
+} // namespace OB
+
+#endif // OB_PLAN_HH
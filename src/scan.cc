@@ -0,0 +1,146 @@
+#include "scan.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OB_SCAN_X86 1
+#include <immintrin.h>
+#else
+#define OB_SCAN_X86 0
+#endif
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace OB
+{
+
+namespace
+{
+
+void scalar(char const* first, char const* last, std::vector<size_t>& out)
+{
+  char const* pos {first};
+  while (pos != last)
+  {
+    auto const nl = static_cast<char const*>(std::memchr(pos, '\n', static_cast<size_t>(last - pos)));
+    if (nl == nullptr) break;
+    out.emplace_back(static_cast<size_t>(nl - first));
+    pos = nl + 1;
+  }
+}
+
+// one bit per byte of a block, set where the byte is a newline
+inline void bits(uint32_t mask, size_t off, std::vector<size_t>& out)
+{
+  while (mask != 0)
+  {
+    out.emplace_back(off + static_cast<size_t>(__builtin_ctz(mask)));
+    mask &= mask - 1;
+  }
+}
+
+#if OB_SCAN_X86
+
+__attribute__((target("sse2")))
+void sse2(char const* first, char const* last, std::vector<size_t>& out)
+{
+  size_t const size {static_cast<size_t>(last - first)};
+  __m128i const nl {_mm_set1_epi8('\n')};
+  size_t i {0};
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i const block {_mm_loadu_si128(reinterpret_cast<__m128i const*>(first + i))};
+    bits(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, nl))), i, out);
+  }
+
+  size_t const done {out.size()};
+  scalar(first + i, last, out);
+  for (size_t j = done; j < out.size(); ++j) out[j] += i;
+}
+
+__attribute__((target("avx2")))
+void avx2(char const* first, char const* last, std::vector<size_t>& out)
+{
+  size_t const size {static_cast<size_t>(last - first)};
+  __m256i const nl {_mm256_set1_epi8('\n')};
+  size_t i {0};
+  for (; i + 32 <= size; i += 32)
+  {
+    __m256i const block {_mm256_loadu_si256(reinterpret_cast<__m256i const*>(first + i))};
+    bits(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl))), i, out);
+  }
+
+  size_t const done {out.size()};
+  scalar(first + i, last, out);
+  for (size_t j = done; j < out.size(); ++j) out[j] += i;
+}
+
+#endif
+
+} // namespace
+
+Scan::Kernel Scan::kernel()
+{
+  static Kernel const k {supported(Kernel::avx2) ? Kernel::avx2 :
+    supported(Kernel::sse2) ? Kernel::sse2 : Kernel::scalar};
+  return k;
+}
+
+bool Scan::supported(Kernel k)
+{
+  switch (k)
+  {
+#if OB_SCAN_X86
+    case Kernel::avx2:
+      return __builtin_cpu_supports("avx2");
+    case Kernel::sse2:
+      return __builtin_cpu_supports("sse2");
+#endif
+    case Kernel::scalar:
+      return true;
+    default:
+      return false;
+  }
+}
+
+char const* Scan::name(Kernel k)
+{
+  switch (k)
+  {
+    case Kernel::avx2:
+      return "avx2";
+    case Kernel::sse2:
+      return "sse2";
+    case Kernel::scalar:
+      return "scalar";
+    default:
+      return "";
+  }
+}
+
+void Scan::newlines(char const* first, char const* last, std::vector<size_t>& out)
+{
+  newlines(kernel(), first, last, out);
+}
+
+void Scan::newlines(Kernel k, char const* first, char const* last, std::vector<size_t>& out)
+{
+  switch (k)
+  {
+#if OB_SCAN_X86
+    case Kernel::avx2:
+      avx2(first, last, out);
+      return;
+    case Kernel::sse2:
+      sse2(first, last, out);
+      return;
+#endif
+    case Kernel::scalar:
+    default:
+      scalar(first, last, out);
+      return;
+  }
+}
+
+} // namespace OB
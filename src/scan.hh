@@ -0,0 +1,35 @@
+#ifndef OB_SCAN_HH
+#define OB_SCAN_HH
+
+#include <vector>
+#include <cstddef>
+
+namespace OB
+{
+
+// vectorized search for newlines,
+// the kernel is picked once for the cpu the program runs on
+class Scan
+{
+public:
+  enum class Kernel
+  {
+    scalar,
+    sse2,
+    avx2
+  };
+
+  // the fastest kernel the cpu supports
+  static Kernel kernel();
+  static bool supported(Kernel k);
+  static char const* name(Kernel k);
+
+  // append the offset of every newline in [first, last), relative to first
+  static void newlines(char const* first, char const* last, std::vector<size_t>& out);
+  static void newlines(Kernel k, char const* first, char const* last, std::vector<size_t>& out);
+
+}; // class Scan
+
+} // namespace OB
+
+#endif // OB_SCAN_HH
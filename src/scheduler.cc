@@ -0,0 +1,155 @@
+#include "scheduler.hh"
+#include "timeline.hh"
+
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// v * num / den without overflowing the intermediate product
+static int64_t scale(int64_t v, int64_t num, int64_t den)
+{
+  return v / den * num + v % den * num / den;
+}
+
+Scheduler::Scheduler()
+{
+}
+
+Scheduler::~Scheduler()
+{
+}
+
+Scheduler::Skip Scheduler::skip(std::string const& str)
+{
+  if (str == "drop") return Skip::drop;
+  if (str == "catchup") return Skip::catchup;
+  if (str == "none") return Skip::none;
+  throw std::runtime_error("invalid skip policy '" + str + "'");
+}
+
+Scheduler& Scheduler::set_skip(Skip skip)
+{
+  skip_ = skip;
+  return *this;
+}
+
+void Scheduler::start(Timeline const& timeline, size_t n)
+{
+  timeline_ = &timeline;
+  base_ = static_cast<int64_t>(timeline.delay());
+  delay_ = base_;
+  dropped_ = 0;
+  paused_ = false;
+  rebase(offset(n));
+}
+
+void Scheduler::seek(size_t n)
+{
+  media_ = offset(n);
+  anchor_ = Clock::now();
+}
+
+void Scheduler::set_delay(size_t delay)
+{
+  if (! paused_)
+  {
+    rebase(media(Clock::now()));
+  }
+  delay_ = delay > 0 ? static_cast<int64_t>(delay) : 1;
+}
+
+void Scheduler::pause()
+{
+  if (paused_) return;
+  rebase(media(Clock::now()));
+  paused_ = true;
+}
+
+void Scheduler::resume()
+{
+  if (! paused_) return;
+  anchor_ = Clock::now();
+  paused_ = false;
+}
+
+bool Scheduler::paused() const
+{
+  return paused_;
+}
+
+Scheduler::Clock::time_point Scheduler::deadline(size_t n) const
+{
+  if (paused_) return Clock::time_point::max();
+  auto const ns = scale(offset(n) - media_, delay_, base_);
+  return anchor_ + std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(ns));
+}
+
+size_t Scheduler::position(Clock::time_point tp) const
+{
+  return timeline_->position(media(tp));
+}
+
+size_t Scheduler::next(size_t n)
+{
+  size_t const want {n + 1};
+  if (paused_) return want;
+
+  auto const now = Clock::now();
+  if (deadline(want) >= now) return want;
+
+  switch (skip_)
+  {
+    case Skip::drop:
+    {
+      size_t const due {position(now)};
+      if (due > want)
+      {
+        dropped_ += due - want;
+        return due;
+      }
+      return want;
+    }
+
+    case Skip::catchup:
+    {
+      return want;
+    }
+
+    case Skip::none:
+    default:
+    {
+      rebase(offset(want));
+      return want;
+    }
+  }
+}
+
+size_t Scheduler::dropped() const
+{
+  return dropped_;
+}
+
+int64_t Scheduler::media(Clock::time_point tp) const
+{
+  if (paused_) return media_;
+  auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>(tp - anchor_).count();
+  return media_ + scale(ns, base_, delay_);
+}
+
+int64_t Scheduler::offset(size_t n) const
+{
+  return timeline_->offset(n);
+}
+
+void Scheduler::rebase(int64_t media)
+{
+  media_ = media;
+  anchor_ = Clock::now();
+}
+
+} // namespace OB
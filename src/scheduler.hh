@@ -0,0 +1,91 @@
+#ifndef OB_SCHEDULER_HH
+#define OB_SCHEDULER_HH
+
+#include "timeline.hh"
+
+#include <chrono>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// maps frame sequence numbers onto absolute steady_clock deadlines
+// through the timeline of the frame delays,
+// the sequence number keeps counting up across loops
+class Scheduler
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // what to do when the player falls behind its deadlines
+  enum class Skip
+  {
+    // jump to the frame that is due now
+    drop,
+    // show every frame, as fast as possible until back on time
+    catchup,
+    // show every frame, move the timeline back so nothing is skipped
+    none,
+  };
+
+  Scheduler();
+  ~Scheduler();
+
+  static Skip skip(std::string const& str);
+
+  Scheduler& set_skip(Skip skip);
+
+  // anchor sequence number n at the current time,
+  // the timeline may grow while it is used but must outlive the scheduler
+  void start(Timeline const& timeline, size_t n = 0);
+
+  // move the timeline so that sequence number n is due now
+  void seek(size_t n);
+
+  // change the default frame delay, the frames with a delay of their own
+  // are scaled by the same amount, the position on the timeline is kept
+  void set_delay(size_t delay);
+
+  void pause();
+  void resume();
+  bool paused() const;
+
+  // point in time at which sequence number n is due
+  Clock::time_point deadline(size_t n) const;
+
+  // sequence number that is due at the given time
+  size_t position(Clock::time_point tp) const;
+
+  // sequence number to show after n, according to the skip policy
+  size_t next(size_t n);
+
+  // total number of frames skipped
+  size_t dropped() const;
+
+private:
+  Skip skip_ {Skip::drop};
+  bool paused_ {false};
+  size_t dropped_ {0};
+  Timeline const* timeline_ {nullptr};
+
+  // the delay the timeline is measured in, set on start
+  int64_t base_ {1};
+
+  // the current delay, base_ / delay_ is the playback rate
+  int64_t delay_ {1};
+
+  // media time in nanoseconds at the anchor point
+  int64_t media_ {0};
+  Clock::time_point anchor_;
+
+  int64_t media(Clock::time_point tp) const;
+  int64_t offset(size_t n) const;
+  void rebase(int64_t media);
+
+}; // class Scheduler
+
+} // namespace OB
+
+#endif // OB_SCHEDULER_HH
@@ -0,0 +1,104 @@
+#ifndef OB_SOURCE_HH
+#define OB_SOURCE_HH
+
+#include <cstddef>
+
+namespace OB
+{
+
+struct Region;
+
+// a line stored once and shared by every frame it appears in,
+// it is followed by a newline
+struct Row
+{
+  // offset of the first byte, relative to the data of a view
+  size_t off {0};
+
+  // number of bytes, the newline is not included
+  size_t len {0};
+}; // struct Row
+
+// a frame ready to be rendered,
+// the bytes and the line table it points to are owned by its source
+struct View
+{
+  // output-ready bytes, the trailing newline is not included,
+  // with rows set the lines are not stored back to back
+  // and size is what they add up to
+  char const* data {nullptr};
+  size_t size {0};
+
+  // number of lines
+  size_t height {0};
+
+  // length of the longest line
+  size_t width {0};
+
+  // start of each line, relative to data,
+  // or with rows set, the index of each line in rows
+  size_t const* lines {nullptr};
+
+  // the rows of an interned plan
+  Row const* rows {nullptr};
+
+  // color regions, drawn in order over the default style
+  Region const* regions {nullptr};
+  size_t region_count {0};
+
+  // time on screen in milliseconds, 0 for the default delay
+  size_t delay {0};
+
+  char const* line(size_t n, size_t& len) const
+  {
+    if (rows)
+    {
+      auto const& row = rows[lines[n]];
+      len = row.len;
+      return data + row.off;
+    }
+    size_t const end {n + 1 < height ? lines[n + 1] - 1 : size};
+    len = end - lines[n];
+    return data + lines[n];
+  }
+}; // struct View
+
+// where the playback loop gets its frames from
+class Source
+{
+public:
+  virtual ~Source()
+  {
+  }
+
+  // number of frames, 0 while it is not known yet
+  virtual size_t size() const = 0;
+
+  // get frame i, returns false when i is past the last frame,
+  // the views of the last two frames requested stay valid
+  virtual bool view(size_t i, View& v) = 0;
+
+  // called while the player is idle, to get ahead without blocking
+  virtual void prefetch()
+  {
+  }
+
+  // whether frame i can be viewed out of sequence without blocking,
+  // so that playback can seek to it
+  virtual bool seekable(size_t i) const
+  {
+    return false;
+  }
+
+  // whether every view stays valid for the lifetime of the source,
+  // and view may be called from another thread at the same time
+  virtual bool stable() const
+  {
+    return false;
+  }
+
+}; // class Source
+
+} // namespace OB
+
+#endif // OB_SOURCE_HH
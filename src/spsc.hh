@@ -0,0 +1,77 @@
+#ifndef OB_SPSC_HH
+#define OB_SPSC_HH
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace OB
+{
+
+// bounded lock-free queue for exactly one producer thread
+// and one consumer thread, the capacity is rounded up to a power of two
+template<typename T>
+class Spsc
+{
+public:
+  explicit Spsc(size_t capacity)
+  {
+    size_t size {1};
+    while (size < capacity) size <<= 1;
+    ring_.resize(size);
+    mask_ = size - 1;
+  }
+
+  Spsc(Spsc const&) = delete;
+  Spsc& operator=(Spsc const&) = delete;
+
+  // producer, false when full
+  bool push(T const& val)
+  {
+    size_t const tail {tail_.load(std::memory_order_relaxed)};
+    if (tail - head_.load(std::memory_order_acquire) == ring_.size()) return false;
+    ring_[tail & mask_] = val;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer, false when empty
+  bool pop(T& val)
+  {
+    if (! front(val)) return false;
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer, look at the next value without removing it
+  bool front(T& val) const
+  {
+    size_t const head {head_.load(std::memory_order_relaxed)};
+    if (head == tail_.load(std::memory_order_acquire)) return false;
+    val = ring_[head & mask_];
+    return true;
+  }
+
+  // either side, may be stale by the time it returns
+  bool empty() const
+  {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+private:
+  std::vector<T> ring_;
+  size_t mask_ {0};
+
+  // the indices only grow, padded apart so that each side
+  // writes to its own cache line
+  char pad0_[64];
+  std::atomic<size_t> head_ {0};
+  char pad1_[64];
+  std::atomic<size_t> tail_ {0};
+  char pad2_[64];
+
+}; // class Spsc
+
+} // namespace OB
+
+#endif // OB_SPSC_HH
@@ -0,0 +1,243 @@
+#include "stats.hh"
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+size_t const Histogram::sub_bits;
+size_t const Histogram::buckets;
+
+void Histogram::add(uint64_t val)
+{
+  ++counts_[index(val)];
+  if (count_ == 0 || val < min_) min_ = val;
+  if (val > max_) max_ = val;
+  ++count_;
+  sum_ += static_cast<double>(val);
+}
+
+uint64_t Histogram::count() const
+{
+  return count_;
+}
+
+uint64_t Histogram::min() const
+{
+  return min_;
+}
+
+uint64_t Histogram::max() const
+{
+  return max_;
+}
+
+double Histogram::mean() const
+{
+  return count_ > 0 ? sum_ / static_cast<double>(count_) : 0.0;
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+  if (count_ == 0) return 0;
+
+  auto const rank = static_cast<uint64_t>(p / 100.0 * static_cast<double>(count_ - 1));
+  uint64_t seen {0};
+  for (size_t i = 0; i < counts_.size(); ++i)
+  {
+    seen += counts_[i];
+    if (seen > rank) return std::max(lower(i), min_);
+  }
+  return max_;
+}
+
+void Histogram::write_json(std::ostream& os) const
+{
+  os << "{\"count\": " << count_
+  << ", \"min\": " << min_
+  << ", \"max\": " << max_
+  << ", \"mean\": " << std::fixed << std::setprecision(1) << mean()
+  << ", \"p50\": " << percentile(50)
+  << ", \"p90\": " << percentile(90)
+  << ", \"p99\": " << percentile(99)
+  << ", \"p999\": " << percentile(99.9)
+  << ", \"buckets\": [";
+
+  // only buckets that were hit, each as [lower bound, count]
+  bool first {true};
+  for (size_t i = 0; i < counts_.size(); ++i)
+  {
+    if (counts_[i] == 0) continue;
+    os << (first ? "" : ", ") << "[" << lower(i) << ", " << counts_[i] << "]";
+    first = false;
+  }
+  os << "]}";
+}
+
+size_t Histogram::index(uint64_t val)
+{
+  // values below 2^sub_bits get a bucket each
+  if (val < (1ull << sub_bits)) return static_cast<size_t>(val);
+
+  size_t const msb {static_cast<size_t>(63 - __builtin_clzll(val))};
+  size_t const shift {msb - sub_bits};
+  size_t const sub {static_cast<size_t>((val >> shift) & ((1ull << sub_bits) - 1))};
+  return ((shift + 1) << sub_bits) + sub;
+}
+
+uint64_t Histogram::lower(size_t idx)
+{
+  if (idx < (1ull << sub_bits)) return idx;
+
+  size_t const shift {(idx >> sub_bits) - 1};
+  uint64_t const sub {idx & ((1ull << sub_bits) - 1)};
+  return ((1ull << sub_bits) + sub) << shift;
+}
+
+Stats::Stats(size_t window) :
+  size_ {std::max(window, static_cast<size_t>(1))}
+{
+  window_.reserve(size_);
+}
+
+void Stats::add(Sample const& sample, size_t dropped, size_t slow)
+{
+  ++frames_;
+  dropped_ = dropped;
+  slow_ = slow;
+  bytes_ += sample.bytes;
+  last_ = sample;
+
+  if (window_.size() < size_)
+  {
+    window_.emplace_back(sample);
+  }
+  else
+  {
+    window_[pos_] = sample;
+    pos_ = (pos_ + 1) % window_.size();
+  }
+
+  render_.add(sample.render);
+  write_.add(sample.write);
+  bytes_hist_.add(sample.bytes);
+  jitter_.add(sample.jitter);
+}
+
+void Stats::set_dedup(Dedup const& dedup)
+{
+  dedup_ = dedup;
+}
+
+void Stats::set_packing(Packing const& packing)
+{
+  packing_ = packing;
+}
+
+size_t Stats::frames() const
+{
+  return frames_;
+}
+
+size_t Stats::dropped() const
+{
+  return dropped_;
+}
+
+size_t Stats::slow() const
+{
+  return slow_;
+}
+
+uint64_t Stats::bytes() const
+{
+  return bytes_;
+}
+
+Stats::Sample const& Stats::last() const
+{
+  return last_;
+}
+
+Stats::Sample Stats::percentile(double p) const
+{
+  Sample res;
+  if (window_.empty()) return res;
+
+  std::vector<uint64_t> vals (window_.size());
+  size_t const rank {static_cast<size_t>(p / 100.0 * static_cast<double>(vals.size() - 1))};
+  auto const select = [&](uint64_t Sample::* field)
+  {
+    for (size_t i = 0; i < window_.size(); ++i)
+    {
+      vals[i] = window_[i].*field;
+    }
+    std::nth_element(vals.begin(), vals.begin() + static_cast<std::ptrdiff_t>(rank), vals.end());
+    return vals[rank];
+  };
+
+  res.render = select(&Sample::render);
+  res.write = select(&Sample::write);
+  res.bytes = select(&Sample::bytes);
+  res.jitter = select(&Sample::jitter);
+  return res;
+}
+
+void Stats::write_json(std::ostream& os) const
+{
+  os << "{\n";
+  os << "  \"frames\": " << frames_ << ",\n";
+  os << "  \"dropped\": " << dropped_ << ",\n";
+  os << "  \"slow\": " << slow_ << ",\n";
+  os << "  \"bytes\": " << bytes_ << ",\n";
+  os << "  \"render_ns\": ";
+  render_.write_json(os);
+  os << ",\n  \"write_ns\": ";
+  write_.write_json(os);
+  os << ",\n  \"jitter_ns\": ";
+  jitter_.write_json(os);
+  os << ",\n  \"bytes_per_frame\": ";
+  bytes_hist_.write_json(os);
+  if (dedup_.skipped)
+  {
+    os << ",\n  \"dedup\": {\"interned\": false"
+    << ", \"skipped\": true"
+    << ", \"estimate\": " << std::fixed << std::setprecision(2) << dedup_.estimate
+    << ", \"rows\": " << dedup_.rows
+    << ", \"frames\": " << dedup_.frames
+    << ", \"bytes\": " << dedup_.bytes << "}";
+  }
+  else if (dedup_.rows > 0)
+  {
+    os << ",\n  \"dedup\": {\"interned\": " << (dedup_.interned ? "true" : "false")
+    << ", \"estimate\": " << std::fixed << std::setprecision(2) << dedup_.estimate
+    << ", \"rows\": " << dedup_.rows
+    << ", \"unique_rows\": " << dedup_.unique_rows
+    << ", \"frames\": " << dedup_.frames
+    << ", \"unique_frames\": " << dedup_.unique_frames
+    << ", \"bytes\": " << dedup_.bytes
+    << ", \"stored\": " << dedup_.stored
+    << ", \"saved\": " << (dedup_.bytes > dedup_.stored ? dedup_.bytes - dedup_.stored : 0)
+    << ", \"ratio\": " << std::fixed << std::setprecision(2) << dedup_.ratio() << "}";
+  }
+  if (packing_.interval > 0)
+  {
+    os << ",\n  \"packing\": {\"bytes\": " << packing_.bytes
+    << ", \"packed\": " << packing_.packed
+    << ", \"interval\": " << packing_.interval
+    << ", \"window\": " << packing_.window
+    << ", \"misses\": " << packing_.misses
+    << ", \"unpack_ns\": ";
+    packing_.unpack.write_json(os);
+    os << "}";
+  }
+  os << "\n}\n";
+}
+
+} // namespace OB
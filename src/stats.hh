@@ -0,0 +1,158 @@
+#ifndef OB_STATS_HH
+#define OB_STATS_HH
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// log-linear histogram, every power of two is split into 8 buckets,
+// so a value is placed within 12.5% of its size
+class Histogram
+{
+public:
+  void add(uint64_t val);
+
+  uint64_t count() const;
+  uint64_t min() const;
+  uint64_t max() const;
+  double mean() const;
+
+  // lower bound of the bucket holding the given percentile, 0 to 100
+  uint64_t percentile(double p) const;
+
+  void write_json(std::ostream& os) const;
+
+  static size_t index(uint64_t val);
+  static uint64_t lower(size_t idx);
+
+private:
+  static size_t const sub_bits {3};
+  static size_t const buckets {(64 - sub_bits + 1) << sub_bits};
+
+  std::vector<uint64_t> counts_ = std::vector<uint64_t>(buckets, 0);
+  uint64_t count_ {0};
+  uint64_t min_ {0};
+  uint64_t max_ {0};
+  double sum_ {0};
+
+}; // class Histogram
+
+// what interning found in the frames of a plan
+struct Dedup
+{
+  size_t rows {0};
+  size_t unique_rows {0};
+  size_t frames {0};
+  size_t unique_frames {0};
+
+  // bytes of frame data and line tables, before and after
+  uint64_t bytes {0};
+  uint64_t stored {0};
+
+  // the plan is left as it is when interning saves too little
+  bool interned {false};
+
+  // share of the bytes of a sample of frames in rows that repeat,
+  // interning is skipped without a full pass when it is too low
+  double estimate {0};
+  bool skipped {false};
+
+  // bytes before for every byte after, 0 when nothing was measured
+  double ratio() const
+  {
+    return stored > 0 ? static_cast<double>(bytes) / static_cast<double>(stored) : 0.0;
+  }
+}; // struct Dedup
+
+// how the frames were packed to fit the memory budget,
+// and what unpacking them cost
+struct Packing
+{
+  // bytes of frame data and line tables, before and after
+  uint64_t bytes {0};
+  uint64_t packed {0};
+
+  // frames from one whole frame to the next
+  size_t interval {0};
+
+  // frames unpacked ahead of playback
+  size_t window {0};
+
+  // frames that were not unpacked ahead by the time they were shown
+  size_t misses {0};
+
+  // nanoseconds to unpack a frame
+  Histogram unpack;
+}; // struct Packing
+
+// per-frame timings of the player, the last frame, a rolling window
+// for the debug overlay and histograms over the whole run
+class Stats
+{
+public:
+  // nanoseconds, except for bytes
+  struct Sample
+  {
+    // building the output of a frame
+    uint64_t render {0};
+
+    // writing it out
+    uint64_t write {0};
+
+    uint64_t bytes {0};
+
+    // how late the frame started after its deadline
+    uint64_t jitter {0};
+  }; // struct Sample
+
+  explicit Stats(size_t window = 128);
+
+  // dropped by the scheduler, slow not sent to a terminal that was behind
+  void add(Sample const& sample, size_t dropped, size_t slow = 0);
+
+  // written along with the timings, when the plan went through interning
+  void set_dedup(Dedup const& dedup);
+
+  // written along with the timings, when the frames were packed
+  void set_packing(Packing const& packing);
+
+  size_t frames() const;
+  size_t dropped() const;
+  size_t slow() const;
+  uint64_t bytes() const;
+  Sample const& last() const;
+
+  // percentile of each field over the rolling window, 0 to 100
+  Sample percentile(double p) const;
+
+  void write_json(std::ostream& os) const;
+
+private:
+  size_t frames_ {0};
+  size_t dropped_ {0};
+  size_t slow_ {0};
+  uint64_t bytes_ {0};
+  Sample last_;
+  Dedup dedup_;
+  Packing packing_;
+
+  // ring of the most recent samples
+  size_t size_ {0};
+  std::vector<Sample> window_;
+  size_t pos_ {0};
+
+  Histogram render_;
+  Histogram write_;
+  Histogram bytes_hist_;
+  Histogram jitter_;
+
+}; // class Stats
+
+} // namespace OB
+
+#endif // OB_STATS_HH
@@ -0,0 +1,286 @@
+#include "stream.hh"
+#include "source.hh"
+#include "plan.hh"
+#include "mmap.hh"
+#include "trace.hh"
+
+#include <unistd.h>
+#include <poll.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdio>
+#include <cerrno>
+
+namespace OB
+{
+
+// bytes requested per read call
+static size_t const chunk_size {65536};
+
+Stream::Keep Stream::keep(std::string const& str)
+{
+  if (str == "spill") return Keep::spill;
+  if (str == "retain") return Keep::retain;
+  throw std::runtime_error("invalid stream loop policy '" + str + "'");
+}
+
+Stream::Stream(int fd, std::string const& delim, size_t capacity, Keep keep) :
+  fd_ {fd},
+  delim_ {delim},
+  keep_ {keep}
+{
+  // the frame on screen and the next frame must fit
+  ring_.resize(capacity < 2 ? 2 : capacity);
+
+  if (keep_ == Keep::spill)
+  {
+    spill_ = std::tmpfile();
+    if (spill_ == nullptr)
+    {
+      throw std::runtime_error("could not create spill file");
+    }
+  }
+}
+
+Stream::~Stream()
+{
+  if (spill_ != nullptr)
+  {
+    std::fclose(spill_);
+  }
+}
+
+bool Stream::line(std::string& str)
+{
+  for (;;)
+  {
+    auto const pos = pending_.find('\n', begin_);
+    if (pos != std::string::npos)
+    {
+      str.assign(pending_, begin_, pos - begin_);
+      begin_ = scan_ = pos + 1;
+      return true;
+    }
+
+    if (closed_)
+    {
+      if (begin_ == pending_.size()) return false;
+      str.assign(pending_, begin_, std::string::npos);
+      begin_ = scan_ = pending_.size();
+      return true;
+    }
+
+    fill(true);
+  }
+}
+
+size_t Stream::size() const
+{
+  return done_ ? count_ : 0;
+}
+
+bool Stream::view(size_t i, View& v)
+{
+  if (done_ && keep_ != Keep::none)
+  {
+    return replay_.view(i, v);
+  }
+
+  while (count_ <= i && ! done_)
+  {
+    parse(i);
+    if (count_ > i || done_) break;
+    fill(true);
+  }
+
+  Slot const* slot {nullptr};
+  if (i >= first_ && i < count_)
+  {
+    slot = ring_.at(i % ring_.size()).get();
+  }
+  else if (held_ && i == held_index_)
+  {
+    slot = held_.get();
+  }
+  else if (i >= count_)
+  {
+    return false;
+  }
+  else
+  {
+    throw std::runtime_error("frame is no longer buffered");
+  }
+
+  v = slot->view;
+  next_ = i + 1;
+
+  return true;
+}
+
+bool Stream::seekable(size_t i) const
+{
+  if (done_ && keep_ != Keep::none)
+  {
+    return replay_.seekable(i);
+  }
+  return (i >= first_ && i < count_) || (held_ && i == held_index_);
+}
+
+void Stream::prefetch()
+{
+  parse(next_);
+  while (! done_ && (count_ - first_ < ring_.size() || first_ < next_) && fill(false))
+  {
+    parse(next_);
+  }
+}
+
+bool Stream::fill(bool block)
+{
+  if (closed_) return false;
+
+  if (! block)
+  {
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) <= 0) return false;
+  }
+
+  if (begin_ > 0)
+  {
+    pending_.erase(0, begin_);
+    scan_ -= begin_;
+    begin_ = 0;
+  }
+
+  size_t const size {pending_.size()};
+  pending_.resize(size + chunk_size);
+
+  Trace::Scope scope {"stream_read"};
+  for (;;)
+  {
+    ssize_t const num {read(fd_, &pending_[size], chunk_size)};
+
+    if (num < 0)
+    {
+      if (errno == EINTR) continue;
+      pending_.resize(size);
+      if (errno == EAGAIN) return false;
+      throw std::runtime_error("read failed");
+    }
+
+    pending_.resize(size + static_cast<size_t>(num));
+
+    if (num == 0)
+    {
+      closed_ = true;
+      return false;
+    }
+
+    return true;
+  }
+}
+
+void Stream::parse(size_t limit)
+{
+  Trace::Scope scope {"stream_parse"};
+
+  // frames below limit may be evicted to make room
+  while (! done_)
+  {
+    if (count_ - first_ == ring_.size() && first_ >= limit) return;
+
+    auto const pos = pending_.find(delim_, scan_);
+    if (pos == std::string::npos)
+    {
+      if (closed_)
+      {
+        // the frame after the last delimiter is always present
+        push(pending_.data() + begin_, pending_.size() - begin_);
+        pending_.clear();
+        begin_ = scan_ = 0;
+        finish();
+      }
+      else if (pending_.size() - begin_ >= delim_.size())
+      {
+        scan_ = pending_.size() - delim_.size() + 1;
+      }
+      return;
+    }
+
+    push(pending_.data() + begin_, pos - begin_);
+    begin_ = scan_ = pos + delim_.size();
+  }
+}
+
+void Stream::push(char const* data, size_t size)
+{
+  if (count_ - first_ == ring_.size())
+  {
+    auto& oldest = ring_.at(first_ % ring_.size());
+    if (next_ > 0 && first_ == next_ - 1)
+    {
+      std::swap(oldest, held_);
+      held_index_ = first_;
+    }
+    ++first_;
+  }
+
+  auto& slot = ring_.at(count_ % ring_.size());
+  if (! slot)
+  {
+    slot = std::make_unique<Slot>();
+  }
+
+  slot->data.assign(data, size);
+  slot->lines.clear();
+  auto& v = slot->view;
+  v.size = size;
+  Plan::measure(slot->data.data(), v.size, v.height, v.width, slot->lines);
+  v.data = slot->data.data();
+  v.lines = slot->lines.data();
+
+  if (keep_ == Keep::spill)
+  {
+    if ((count_ > 0 && std::fwrite(delim_.data(), 1, delim_.size(), spill_) != delim_.size()) ||
+      std::fwrite(data, 1, size, spill_) != size)
+    {
+      throw std::runtime_error("could not write spill file");
+    }
+  }
+  else if (keep_ == Keep::retain)
+  {
+    retained_.emplace_back(data, size);
+  }
+
+  ++count_;
+}
+
+void Stream::finish()
+{
+  done_ = true;
+
+  if (keep_ == Keep::spill)
+  {
+    if (std::fflush(spill_) != 0)
+    {
+      throw std::runtime_error("could not write spill file");
+    }
+    replay_ = Plan(Mmap(fileno(spill_)), 0, delim_);
+  }
+  else if (keep_ == Keep::retain)
+  {
+    replay_ = Plan(retained_);
+    retained_.clear();
+    retained_.shrink_to_fit();
+  }
+}
+
+} // namespace OB
@@ -0,0 +1,103 @@
+#ifndef OB_STREAM_HH
+#define OB_STREAM_HH
+
+#include "source.hh"
+#include "plan.hh"
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdio>
+
+namespace OB
+{
+
+// frames read from a pipe or any other file descriptor that can not be
+// mapped, playback starts as soon as the first frame is complete and only
+// a bounded ring of parsed frames is held in memory
+class Stream : public Source
+{
+public:
+  // what is kept of the played frames so the animation can loop
+  enum class Keep
+  {
+    // nothing, the stream plays once
+    none,
+    // frames are appended to an unlinked temporary file,
+    // which is mapped once the stream has ended
+    spill,
+    // frames are kept in memory
+    retain,
+  };
+
+  static Keep keep(std::string const& str);
+
+  Stream(int fd, std::string const& delim, size_t capacity, Keep keep);
+  Stream(Stream const&) = delete;
+  Stream& operator=(Stream const&) = delete;
+  ~Stream();
+
+  // read a single header line, blocks until it is complete,
+  // returns false at the end of the stream
+  bool line(std::string& str);
+
+  size_t size() const override;
+  bool view(size_t i, View& v) override;
+
+  // frames still in the ring, or any frame once the stream is kept for looping
+  bool seekable(size_t i) const override;
+
+  // read and parse what is available without blocking,
+  // as long as there is room left in the ring
+  void prefetch() override;
+
+private:
+  struct Slot
+  {
+    std::string data;
+    std::vector<size_t> lines;
+    View view;
+  }; // struct Slot
+
+  int fd_ {-1};
+  std::string delim_;
+  Keep keep_ {Keep::none};
+
+  // bytes read but not parsed into frames yet start at begin_,
+  // scan_ is where to resume searching for the delimiter
+  std::string pending_;
+  size_t begin_ {0};
+  size_t scan_ {0};
+
+  // frames first_ to count_ - 1 are in the ring, frame i is in slot i % size,
+  // slots are swapped rather than copied so views into them stay valid
+  std::vector<std::unique_ptr<Slot>> ring_;
+  size_t first_ {0};
+  size_t count_ {0};
+
+  // one past the last frame handed out, that frame is still on screen,
+  // when it has to leave the ring it is moved to the held slot
+  size_t next_ {0};
+  std::unique_ptr<Slot> held_;
+  size_t held_index_ {0};
+
+  // end of file was read, and all frames have been parsed
+  bool closed_ {false};
+  bool done_ {false};
+
+  // looping
+  std::FILE* spill_ {nullptr};
+  std::vector<std::string> retained_;
+  Plan replay_;
+
+  bool fill(bool block);
+  void parse(size_t limit);
+  void push(char const* data, size_t size);
+  void finish();
+
+}; // class Stream
+
+} // namespace OB
+
+#endif // OB_STREAM_HH
@@ -4,14 +4,13 @@
 #include "ansi_escape_codes.hh"
 namespace AEC = OB::ANSI_Escape_Codes;
 
+#include <poll.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <stdexcept>
 #include <iostream>
 #include <cstdio>
-#include <thread>
-#include <chrono>
 
 namespace OB
 {
@@ -19,7 +18,8 @@ namespace OB
 class Term
 {
 public:
-  Term()
+  explicit Term(int fd = STDIN_FILENO) :
+    fd_ {fd}
   {
     cursor_hide();
     set_raw();
@@ -33,7 +33,7 @@ public:
 
   void set_cooked()
   {
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &old_) == -1)
+    if (tcsetattr(fd_, TCSAFLUSH, &old_) == -1)
     {
       throw std::runtime_error("tcsetattr failed");
     }
@@ -41,7 +41,7 @@ public:
 
   void set_raw()
   {
-    if (tcgetattr(STDIN_FILENO, &old_) == -1)
+    if (tcgetattr(fd_, &old_) == -1)
     {
       throw std::runtime_error("tcgetattr failed");
     }
@@ -51,7 +51,7 @@ public:
     raw_.c_cc[VMIN]  = 0;
     raw_.c_cc[VTIME] = 0;
 
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw_) == -1)
+    if (tcsetattr(fd_, TCSAFLUSH, &raw_) == -1)
     {
       throw std::runtime_error("tcsetattr failed");
     }
@@ -89,16 +89,19 @@ public:
     height = w.ws_row;
   }
 
-  static int cursor_get(size_t& width, size_t& height)
+  static int cursor_get(size_t& width, size_t& height, int fd = STDIN_FILENO)
   {
     std::cout << "\033[6n" << std::flush;
     char buf[32];
     uint8_t i = 0;
     for (;i < sizeof(buf) -1; ++i)
     {
-      while (read(STDIN_FILENO, &buf[i], 1) != 1)
+      // wait for the reply instead of polling for it,
+      // give up if the terminal does not answer
+      while (read(fd, &buf[i], 1) != 1)
       {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        struct pollfd pfd {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0) return -1;
       }
       if (buf[i] == 'R') break;
     }
@@ -113,6 +116,7 @@ public:
   }
 
 private:
+  int fd_ {STDIN_FILENO};
   termios old_;
   termios raw_;
 
@@ -0,0 +1,124 @@
+#include "timeline.hh"
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+Timeline::Timeline(size_t delay) :
+  delay_ {static_cast<int64_t>(delay > 0 ? delay : 1) * 1000000},
+  last_ {delay_}
+{
+}
+
+void Timeline::set(size_t n, size_t delay)
+{
+  if (closed_ || n < size_) return;
+
+  int64_t const d {delay > 0 ? static_cast<int64_t>(delay) * 1000000 : delay_};
+
+  // the table is only built once a frame has a delay of its own
+  if (begin_.empty() && d != delay_)
+  {
+    begin_.reserve(n + 2);
+    for (size_t i = 0; i <= size_; ++i)
+    {
+      begin_.emplace_back(static_cast<int64_t>(i) * delay_);
+    }
+  }
+
+  if (! begin_.empty())
+  {
+    while (size_ <= n)
+    {
+      begin_.emplace_back(begin_.back() + d);
+      ++size_;
+    }
+  }
+
+  size_ = n + 1;
+  last_ = d;
+}
+
+void Timeline::close(size_t count)
+{
+  if (closed_) return;
+  if (count > size_ && size_ > 0)
+  {
+    set(count - 1, static_cast<size_t>(last_ / 1000000));
+  }
+  size_ = count;
+  if (! begin_.empty())
+  {
+    begin_.resize(count + 1);
+  }
+  closed_ = true;
+}
+
+bool Timeline::closed() const
+{
+  return closed_;
+}
+
+size_t Timeline::size() const
+{
+  return size_;
+}
+
+size_t Timeline::delay() const
+{
+  return static_cast<size_t>(delay_ / 1000000);
+}
+
+int64_t Timeline::total() const
+{
+  return closed_ ? end() : 0;
+}
+
+int64_t Timeline::offset(size_t n) const
+{
+  int64_t base {0};
+  if (closed_ && size_ > 0)
+  {
+    base = static_cast<int64_t>(n / size_) * end();
+    n %= size_;
+  }
+
+  if (begin_.empty()) return base + static_cast<int64_t>(n) * delay_;
+  if (n <= size_) return base + begin_[n];
+  return base + begin_[size_] + static_cast<int64_t>(n - size_) * last_;
+}
+
+size_t Timeline::position(int64_t t) const
+{
+  if (t <= 0) return 0;
+
+  size_t base {0};
+  if (closed_ && size_ > 0 && end() > 0)
+  {
+    base = static_cast<size_t>(t / end()) * size_;
+    t %= end();
+  }
+
+  if (begin_.empty()) return base + static_cast<size_t>(t / delay_);
+  if (t >= begin_[size_])
+  {
+    // only reached while the timeline is still open
+    return base + size_ + static_cast<size_t>((t - begin_[size_]) / last_);
+  }
+
+  // the last frame that starts at or before t
+  auto const it = std::upper_bound(begin_.begin(), begin_.begin() + static_cast<std::ptrdiff_t>(size_) + 1, t);
+  return base + static_cast<size_t>(it - begin_.begin()) - 1;
+}
+
+int64_t Timeline::end() const
+{
+  if (begin_.empty()) return static_cast<int64_t>(size_) * delay_;
+  return begin_[size_];
+}
+
+} // namespace OB
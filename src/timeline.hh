@@ -0,0 +1,65 @@
+#ifndef OB_TIMELINE_HH
+#define OB_TIMELINE_HH
+
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// the time at which each frame starts, in nanoseconds from the start of the loop,
+// built from the frame delays so that the frame due at a point in time
+// is a binary search, sequence numbers keep counting up across loops
+//
+// frames are added in order as they become known, past the last one known
+// the timeline carries on with the delay of that frame,
+// once closed the frames known make up one loop that repeats
+class Timeline
+{
+public:
+  // the delay of frames without their own, in milliseconds
+  explicit Timeline(size_t delay = 250);
+
+  // frame n stays on screen for delay milliseconds, 0 for the default,
+  // frames before it that were never set take the same delay
+  void set(size_t n, size_t delay);
+
+  // a loop is count frames, frames set past it are dropped
+  void close(size_t count);
+  bool closed() const;
+
+  // number of frames set
+  size_t size() const;
+
+  // the default delay in milliseconds
+  size_t delay() const;
+
+  // length of a loop, 0 while it is not closed
+  int64_t total() const;
+
+  // start of sequence number n
+  int64_t offset(size_t n) const;
+
+  // sequence number due at time t
+  size_t position(int64_t t) const;
+
+private:
+  int64_t delay_ {250000000};
+  size_t size_ {0};
+  bool closed_ {false};
+
+  // the delay of the last frame set
+  int64_t last_ {250000000};
+
+  // start of each frame and the end of the last one,
+  // empty while every frame has the default delay
+  std::vector<int64_t> begin_;
+
+  int64_t end() const;
+
+}; // class Timeline
+
+} // namespace OB
+
+#endif // OB_TIMELINE_HH
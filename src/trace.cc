@@ -0,0 +1,88 @@
+#include "trace.hh"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+uint64_t const Trace::none;
+std::atomic<bool> Trace::enabled_ {false};
+std::atomic<size_t> Trace::head_ {0};
+std::vector<Trace::Event> Trace::ring_;
+Trace::Clock::time_point Trace::epoch_;
+
+// small sequential thread ids, in the order threads first record
+static uint32_t thread_id()
+{
+  static std::atomic<uint32_t> next {1};
+  thread_local uint32_t const id {next.fetch_add(1, std::memory_order_relaxed)};
+  return id;
+}
+
+void Trace::enable(size_t capacity)
+{
+  ring_.assign(capacity > 0 ? capacity : 1, Event());
+  head_.store(0, std::memory_order_relaxed);
+  epoch_ = Clock::now();
+  enabled_.store(true, std::memory_order_release);
+}
+
+void Trace::record(char const* name, Clock::time_point begin, Clock::time_point end, uint64_t arg)
+{
+  if (! enabled()) return;
+
+  // each writer claims its own slot
+  size_t const pos {head_.fetch_add(1, std::memory_order_relaxed) % ring_.size()};
+  auto& e = ring_[pos];
+  e.name = name;
+  e.begin = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - epoch_).count();
+  e.end = std::chrono::duration_cast<std::chrono::nanoseconds>(end - epoch_).count();
+  e.arg = arg;
+  e.tid = thread_id();
+}
+
+void Trace::write(std::string const& file_name)
+{
+  enabled_.store(false, std::memory_order_relaxed);
+
+  std::ofstream ofile {file_name};
+  if (! ofile.is_open())
+  {
+    throw std::runtime_error("could not open trace file");
+  }
+
+  size_t const head {head_.load(std::memory_order_acquire)};
+  size_t const count {head < ring_.size() ? head : ring_.size()};
+  size_t const first {head < ring_.size() ? 0 : head % ring_.size()};
+
+  // timestamps are in microseconds
+  ofile << std::fixed << std::setprecision(3);
+  ofile << "{\"displayTimeUnit\": \"ns\", \"otherData\": {\"events\": " << head << ", \"overwritten\": " << head - count << "}, \"traceEvents\": [\n";
+  ofile << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"asciimation\"}}";
+  for (size_t i = 0; i < count; ++i)
+  {
+    auto const& e = ring_[(first + i) % ring_.size()];
+    if (e.name == nullptr) continue;
+
+    ofile << ",\n{\"name\": \"" << e.name << "\", \"cat\": \"asciimation\", \"ph\": \"X\""
+    << ", \"ts\": " << static_cast<double>(e.begin) / 1000.0
+    << ", \"dur\": " << static_cast<double>(e.end - e.begin) / 1000.0
+    << ", \"pid\": 1, \"tid\": " << e.tid;
+    if (e.arg != none)
+    {
+      ofile << ", \"args\": {\"n\": " << e.arg << "}";
+    }
+    ofile << "}";
+  }
+  ofile << "\n]}\n";
+}
+
+} // namespace OB
@@ -0,0 +1,87 @@
+#ifndef OB_TRACE_HH
+#define OB_TRACE_HH
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// records when each stage of the player ran into a preallocated ring,
+// once the ring is full the oldest events are overwritten,
+// while disabled a trace point costs a single relaxed load
+//
+// events are written out in the chrome trace event format,
+// after every recording thread has stopped
+class Trace
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // no argument attached to an event
+  static uint64_t const none {std::numeric_limits<uint64_t>::max()};
+
+  // allocate room for capacity events and start recording
+  static void enable(size_t capacity);
+
+  static bool enabled()
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  // the name must be a string literal, it is stored as a pointer
+  static void record(char const* name, Clock::time_point begin, Clock::time_point end, uint64_t arg = none);
+
+  static void write(std::string const& file_name);
+
+  // records the lifetime of the scope
+  class Scope
+  {
+  public:
+    explicit Scope(char const* name, uint64_t arg = none) :
+      name_ {name},
+      arg_ {arg}
+    {
+      if (enabled()) begin_ = Clock::now();
+    }
+
+    Scope(Scope const&) = delete;
+    Scope& operator=(Scope const&) = delete;
+
+    ~Scope()
+    {
+      if (enabled()) record(name_, begin_, Clock::now(), arg_);
+    }
+
+  private:
+    char const* name_;
+    uint64_t arg_;
+    Clock::time_point begin_;
+
+  }; // class Scope
+
+private:
+  struct Event
+  {
+    char const* name {nullptr};
+    int64_t begin {0};
+    int64_t end {0};
+    uint64_t arg {none};
+    uint32_t tid {0};
+  }; // struct Event
+
+  static std::atomic<bool> enabled_;
+  static std::atomic<size_t> head_;
+  static std::vector<Event> ring_;
+  static Clock::time_point epoch_;
+
+}; // class Trace
+
+} // namespace OB
+
+#endif // OB_TRACE_HH
@@ -0,0 +1,293 @@
+#include "vt.hh"
+#include "output.hh"
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+Vt::Vt(size_t width, size_t height) :
+  width_ {std::max(width, static_cast<size_t>(1))},
+  height_ {std::max(height, static_cast<size_t>(1))},
+  cells_(width_ * height_, ' ')
+{
+}
+
+void Vt::write(struct iovec* iov, size_t cnt)
+{
+  for (size_t i = 0; i < cnt; ++i)
+  {
+    auto const data = static_cast<char const*>(iov[i].iov_base);
+    for (size_t j = 0; j < iov[i].iov_len; ++j)
+    {
+      char const c {data[j]};
+      switch (state_)
+      {
+        case State::text:
+        {
+          if (c == '\033')
+          {
+            state_ = State::escape;
+          }
+          else if (c == '\n')
+          {
+            x_ = 0;
+            newline();
+          }
+          else if (c == '\r')
+          {
+            x_ = 0;
+            wrap_ = false;
+          }
+          else if (static_cast<unsigned char>(c) >= 0x20 && c != 0x7f)
+          {
+            put(c);
+          }
+          break;
+        }
+
+        case State::escape:
+        {
+          state_ = State::text;
+          if (c == '[')
+          {
+            state_ = State::csi;
+            private_ = false;
+            params_.clear();
+          }
+          else if (c == '7')
+          {
+            saved_x_ = x_;
+            saved_y_ = y_;
+          }
+          else if (c == '8')
+          {
+            x_ = saved_x_;
+            y_ = saved_y_;
+            wrap_ = false;
+          }
+          break;
+        }
+
+        case State::csi:
+        {
+          if (c >= '0' && c <= '9')
+          {
+            if (params_.empty()) params_.emplace_back(0);
+            params_.back() = params_.back() * 10 + static_cast<size_t>(c - '0');
+          }
+          else if (c == ';')
+          {
+            if (params_.empty()) params_.emplace_back(0);
+            params_.emplace_back(0);
+          }
+          else if (c == '?')
+          {
+            private_ = true;
+          }
+          else if (c >= 0x40 && c <= 0x7e)
+          {
+            state_ = State::text;
+            if (! private_) csi(c);
+          }
+          break;
+        }
+
+        default:
+        {
+          break;
+        }
+      }
+    }
+  }
+}
+
+size_t Vt::width() const
+{
+  return width_;
+}
+
+size_t Vt::height() const
+{
+  return height_;
+}
+
+char Vt::at(size_t x, size_t y) const
+{
+  return cells_.at(y * width_ + x);
+}
+
+std::string Vt::screen() const
+{
+  std::string str;
+  size_t blank {0};
+  for (size_t y = 0; y < height_; ++y)
+  {
+    auto const row = cells_.data() + y * width_;
+    size_t len {width_};
+    while (len > 0 && row[len - 1] == ' ') --len;
+
+    if (len == 0)
+    {
+      ++blank;
+      continue;
+    }
+
+    str.append(blank, '\n');
+    blank = 0;
+    str.append(row, len);
+    str += '\n';
+  }
+  return str;
+}
+
+uint64_t Vt::hash() const
+{
+  uint64_t hash {0xcbf29ce484222325ull};
+  for (auto const c : cells_)
+  {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+void Vt::put(char c)
+{
+  // the cursor stays on the last column until the next character,
+  // which then wraps onto the next line
+  if (wrap_)
+  {
+    wrap_ = false;
+    x_ = 0;
+    newline();
+  }
+
+  cells_[y_ * width_ + x_] = c;
+  if (x_ + 1 < width_)
+  {
+    ++x_;
+  }
+  else
+  {
+    wrap_ = true;
+  }
+}
+
+void Vt::newline()
+{
+  wrap_ = false;
+  if (y_ + 1 < height_)
+  {
+    ++y_;
+    return;
+  }
+
+  // scroll up by one row
+  std::copy(cells_.begin() + static_cast<std::ptrdiff_t>(width_), cells_.end(), cells_.begin());
+  std::fill(cells_.end() - static_cast<std::ptrdiff_t>(width_), cells_.end(), ' ');
+}
+
+size_t Vt::param(size_t i, size_t def) const
+{
+  if (i >= params_.size() || params_[i] == 0) return def;
+  return params_[i];
+}
+
+void Vt::erase(size_t x, size_t y, size_t n)
+{
+  std::fill_n(cells_.begin() + static_cast<std::ptrdiff_t>(y * width_ + x), n, ' ');
+}
+
+void Vt::csi(char c)
+{
+  wrap_ = false;
+  switch (c)
+  {
+    // cursor position, 1 based
+    case 'H':
+    case 'f':
+    {
+      y_ = std::min(param(0, 1), height_) - 1;
+      x_ = std::min(param(1, 1), width_) - 1;
+      break;
+    }
+
+    case 'A':
+    {
+      y_ -= std::min(param(0, 1), y_);
+      break;
+    }
+
+    case 'B':
+    {
+      y_ = std::min(y_ + param(0, 1), height_ - 1);
+      break;
+    }
+
+    case 'C':
+    {
+      x_ = std::min(x_ + param(0, 1), width_ - 1);
+      break;
+    }
+
+    case 'D':
+    {
+      x_ -= std::min(param(0, 1), x_);
+      break;
+    }
+
+    // erase in display
+    case 'J':
+    {
+      size_t const mode {params_.empty() ? 0 : params_[0]};
+      if (mode == 0)
+      {
+        erase(x_, y_, width_ - x_);
+        if (y_ + 1 < height_) erase(0, y_ + 1, (height_ - y_ - 1) * width_);
+      }
+      else if (mode == 1)
+      {
+        erase(0, 0, y_ * width_ + x_ + 1);
+      }
+      else if (mode == 2)
+      {
+        erase(0, 0, width_ * height_);
+      }
+      break;
+    }
+
+    // erase in line
+    case 'K':
+    {
+      size_t const mode {params_.empty() ? 0 : params_[0]};
+      if (mode == 0)
+      {
+        erase(x_, y_, width_ - x_);
+      }
+      else if (mode == 1)
+      {
+        erase(0, y_, x_ + 1);
+      }
+      else if (mode == 2)
+      {
+        erase(0, y_, width_);
+      }
+      break;
+    }
+
+    // attributes are not kept
+    default:
+    {
+      break;
+    }
+  }
+}
+
+} // namespace OB
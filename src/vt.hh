@@ -0,0 +1,70 @@
+#ifndef OB_VT_HH
+#define OB_VT_HH
+
+#include "output.hh"
+
+#include <sys/uio.h>
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace OB
+{
+
+// an in-memory terminal, it understands the cursor movement and erase
+// sequences the player emits, newlines return the carriage as a tty would,
+// attributes are parsed and ignored
+class Vt : public Sink
+{
+public:
+  Vt(size_t width, size_t height);
+
+  void write(struct iovec* iov, size_t cnt) override;
+
+  size_t width() const;
+  size_t height() const;
+
+  // the cell at column x and row y, 0 based
+  char at(size_t x, size_t y) const;
+
+  // the rows of the screen, trailing blanks and blank rows removed
+  std::string screen() const;
+
+  // hash of the screen contents
+  uint64_t hash() const;
+
+private:
+  enum class State
+  {
+    text,
+    escape,
+    csi,
+  };
+
+  size_t width_ {0};
+  size_t height_ {0};
+  std::vector<char> cells_;
+
+  size_t x_ {0};
+  size_t y_ {0};
+  bool wrap_ {false};
+  size_t saved_x_ {0};
+  size_t saved_y_ {0};
+
+  State state_ {State::text};
+  bool private_ {false};
+  std::vector<size_t> params_;
+
+  void put(char c);
+  void newline();
+  void csi(char c);
+  size_t param(size_t i, size_t def) const;
+  void erase(size_t x, size_t y, size_t n);
+
+}; // class Vt
+
+} // namespace OB
+
+#endif // OB_VT_HH